@@ -0,0 +1,70 @@
+// Piece hashing throughput: one piece at a time vs CoreSha1_hash_many, for every kernel the CPU has
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <CoreSha1.h>
+
+#define PIECE_COUNT 256
+#define PIECE_LENGTH (256 * 1024)
+#define ROUNDS 4
+
+static const struct { CoreSha1Implementation implementation; const char *name; } implementations[] = {
+    { CORE_SHA1_IMPL_SCALAR, "scalar" },
+    { CORE_SHA1_IMPL_SHA_NI, "sha-ni" },
+    { CORE_SHA1_IMPL_ARMV8, "armv8" },
+    { CORE_SHA1_IMPL_AVX2, "avx2" },
+    { CORE_SHA1_IMPL_AVX512, "avx512" },
+};
+
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+static double megabytes_per_second(double seconds) {
+    return (double)PIECE_COUNT * PIECE_LENGTH * ROUNDS / (1024.0 * 1024.0) / seconds;
+}
+
+int main(void) {
+    uint8_t *data = malloc((size_t)PIECE_COUNT * PIECE_LENGTH);
+    const uint8_t **pieces = malloc(PIECE_COUNT * sizeof(*pieces));
+    uint8_t (*digests)[CORE_SHA1_DIGEST_LENGTH] = malloc(PIECE_COUNT * sizeof(*digests));
+    if (!data || !pieces || !digests) {
+        fprintf(stderr, "Allocation failed\n");
+        return EXIT_FAILURE;
+    }
+    for (size_t i = 0; i < (size_t)PIECE_COUNT * PIECE_LENGTH; i++) {
+        data[i] = (uint8_t)(i * 2654435761u >> 24);
+    }
+    for (size_t i = 0; i < PIECE_COUNT; i++) {
+        pieces[i] = data + i * PIECE_LENGTH;
+    }
+
+    printf("%d pieces of %d KiB\n", PIECE_COUNT, PIECE_LENGTH / 1024);
+    printf("%-8s %14s %14s\n", "kernel", "single MB/s", "many MB/s");
+    for (size_t k = 0; k < sizeof(implementations) / sizeof(implementations[0]); k++) {
+        if (!CoreSha1_set_implementation(implementations[k].implementation)) continue;
+
+        double start = now_seconds();
+        for (int round = 0; round < ROUNDS; round++) {
+            for (size_t i = 0; i < PIECE_COUNT; i++) {
+                CoreSha1_hash(pieces[i], PIECE_LENGTH, digests[i]);
+            }
+        }
+        double single = now_seconds() - start;
+
+        start = now_seconds();
+        for (int round = 0; round < ROUNDS; round++) {
+            CoreSha1_hash_many(pieces, PIECE_LENGTH, PIECE_COUNT, digests);
+        }
+        double many = now_seconds() - start;
+
+        printf("%-8s %14.1f %14.1f\n", implementations[k].name, megabytes_per_second(single), megabytes_per_second(many));
+    }
+
+    free(digests);
+    free(pieces);
+    free(data);
+    return EXIT_SUCCESS;
+}
@@ -27,9 +27,9 @@ int main(void) {
     CoreFile_close(f);
 
     BencodeItem *root = BencodeItem_parse(buf, sz);
-    free(buf);
     if (!root || root->type != BENCODE_TYPE_DICTIONARY) {
         fprintf(stderr, "Invalid torrent\n");
+        free(buf);
         return 1;
     }
 
@@ -39,12 +39,14 @@ int main(void) {
     } else {
         if (mkdir("./downloads", 0755) != 0) {
             fprintf(stderr, "Failed to create downloads directory\n");
+            free(buf);
             return 1;
         }
     }
 
-    // Create and use TorrentDownloader
-    TorrentDownloader *dl = TorrentDownloader_create(root, "./downloads");
+    // Create and use TorrentDownloader, the raw bytes are only needed for the info-hash
+    TorrentDownloader *dl = TorrentDownloader_create_with_source(root, buf, sz, "./downloads");
+    free(buf);
     if (!dl) {
         fprintf(stderr, "Failed to initialize downloader\n");
         return 1;
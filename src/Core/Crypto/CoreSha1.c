@@ -0,0 +1,596 @@
+#include "CoreSha1.h"
+#include <string.h>
+#include <pthread.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <cpuid.h>
+#include <immintrin.h>
+#define CORE_SHA1_X86 1
+#endif
+
+#if defined(__aarch64__)
+#if defined(__ARM_FEATURE_SHA2) || defined(__ARM_FEATURE_CRYPTO)
+#define CORE_SHA1_HAVE_ARMV8 1
+#define CORE_SHA1_ARMV8_TARGET
+#elif defined(__GNUC__) && !defined(__clang__)
+#define CORE_SHA1_HAVE_ARMV8 1
+#define CORE_SHA1_ARMV8_TARGET __attribute__((target("+crypto")))
+#endif
+#endif
+
+#if defined(CORE_SHA1_HAVE_ARMV8)
+#include <arm_neon.h>
+#if defined(__linux__)
+#include <sys/auxv.h>
+#include <asm/hwcap.h>
+#endif
+#endif
+
+// Processes count 64-byte blocks
+typedef void (*CoreSha1CompressFn)(uint32_t state[5], const uint8_t *blocks, size_t count);
+
+static const uint32_t sha1_k[4] = { 0x5A827999, 0x6ED9EBA1, 0x8F1BBCDC, 0xCA62C1D6 };
+
+static inline uint32_t rotl32(uint32_t x, int n) {
+    return (x << n) | (x >> (32 - n));
+}
+
+static inline uint32_t load_be32(const uint8_t *p) {
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | (uint32_t)p[3];
+}
+
+static void compress_scalar(uint32_t state[5], const uint8_t *blocks, size_t count) {
+    for (; count > 0; count--, blocks += CORE_SHA1_BLOCK_LENGTH) {
+        uint32_t w[16]; // The message schedule is kept as a 16 word ring
+        for (int i = 0; i < 16; i++) {
+            w[i] = load_be32(blocks + i * 4);
+        }
+
+        uint32_t a = state[0], b = state[1], c = state[2], d = state[3], e = state[4];
+        for (int i = 0; i < 80; i++) {
+            if (i >= 16) {
+                w[i & 15] = rotl32(w[(i + 13) & 15] ^ w[(i + 8) & 15] ^ w[(i + 2) & 15] ^ w[i & 15], 1);
+            }
+
+            uint32_t f;
+            if (i < 20) {
+                f = (b & c) | (~b & d);
+            } else if (i < 40) {
+                f = b ^ c ^ d;
+            } else if (i < 60) {
+                f = (b & c) | (b & d) | (c & d);
+            } else {
+                f = b ^ c ^ d;
+            }
+
+            uint32_t temp = rotl32(a, 5) + f + e + sha1_k[i / 20] + w[i & 15];
+            e = d;
+            d = c;
+            c = rotl32(b, 30);
+            b = a;
+            a = temp;
+        }
+
+        state[0] += a;
+        state[1] += b;
+        state[2] += c;
+        state[3] += d;
+        state[4] += e;
+    }
+}
+
+#if defined(CORE_SHA1_X86)
+// Four rounds per step, the message schedule for later steps is computed while the rounds run.
+// Step 0 seeds e0 with an add instead of sha1nexte, the ranges skip schedule work nobody needs.
+#define SHA_NI_STEP(i) do { \
+        if ((i) & 1) { e1 = _mm_sha1nexte_epu32(e1, msg[(i) % 4]); e0 = abcd; } \
+        else         { e0 = _mm_sha1nexte_epu32(e0, msg[(i) % 4]); e1 = abcd; } \
+        if ((i) >= 3 && (i) <= 18) msg[((i) + 1) % 4] = _mm_sha1msg2_epu32(msg[((i) + 1) % 4], msg[(i) % 4]); \
+        abcd = _mm_sha1rnds4_epu32(abcd, ((i) & 1) ? e1 : e0, (i) / 5); \
+        if ((i) >= 1 && (i) <= 16) msg[((i) + 3) % 4] = _mm_sha1msg1_epu32(msg[((i) + 3) % 4], msg[(i) % 4]); \
+        if ((i) >= 2 && (i) <= 17) msg[((i) + 2) % 4] = _mm_xor_si128(msg[((i) + 2) % 4], msg[(i) % 4]); \
+    } while (0)
+
+__attribute__((target("sha,ssse3,sse4.1")))
+static void compress_sha_ni(uint32_t state[5], const uint8_t *blocks, size_t count) {
+    const __m128i byte_swap = _mm_set_epi64x(0x0001020304050607LL, 0x08090a0b0c0d0e0fLL);
+    __m128i abcd = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i *)state), 0x1B);
+    __m128i e0 = _mm_set_epi32((int)state[4], 0, 0, 0);
+    __m128i e1;
+    __m128i msg[4];
+
+    for (; count > 0; count--, blocks += CORE_SHA1_BLOCK_LENGTH) {
+        __m128i abcd_save = abcd;
+        __m128i e0_save = e0;
+
+        for (int i = 0; i < 4; i++) {
+            msg[i] = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(blocks + i * 16)), byte_swap);
+        }
+
+        e0 = _mm_add_epi32(e0, msg[0]);
+        e1 = abcd;
+        abcd = _mm_sha1rnds4_epu32(abcd, e0, 0);
+
+        SHA_NI_STEP(1);  SHA_NI_STEP(2);  SHA_NI_STEP(3);  SHA_NI_STEP(4);
+        SHA_NI_STEP(5);  SHA_NI_STEP(6);  SHA_NI_STEP(7);  SHA_NI_STEP(8);
+        SHA_NI_STEP(9);  SHA_NI_STEP(10); SHA_NI_STEP(11); SHA_NI_STEP(12);
+        SHA_NI_STEP(13); SHA_NI_STEP(14); SHA_NI_STEP(15); SHA_NI_STEP(16);
+        SHA_NI_STEP(17); SHA_NI_STEP(18); SHA_NI_STEP(19);
+
+        e0 = _mm_sha1nexte_epu32(e0, e0_save);
+        abcd = _mm_add_epi32(abcd, abcd_save);
+    }
+
+    _mm_storeu_si128((__m128i *)state, _mm_shuffle_epi32(abcd, 0x1B));
+    state[4] = (uint32_t)_mm_extract_epi32(e0, 3);
+}
+
+static bool cpu_has_sha_ni(void) {
+    unsigned int eax, ebx, ecx, edx;
+    if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx)) return false;
+    bool ssse3 = (ecx & bit_SSSE3) != 0;
+    bool sse41 = (ecx & bit_SSE4_1) != 0;
+    if (!__get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx)) return false;
+    return ssse3 && sse41 && (ebx & bit_SHA) != 0;
+}
+#endif
+
+#if defined(CORE_SHA1_HAVE_ARMV8)
+// Same idea as SHA-NI: four rounds per step, schedule and round constants prepared ahead
+#define ARMV8_STEP(i, op) do { \
+        uint32_t e_next = vsha1h_u32(vgetq_lane_u32(abcd, 0)); \
+        abcd = op(abcd, e[(i) % 2], tmp[(i) % 2]); \
+        e[((i) + 1) % 2] = e_next; \
+        if ((i) <= 17) tmp[(i) % 2] = vaddq_u32(msg[((i) + 2) % 4], vdupq_n_u32(sha1_k[(((i) + 2) / 5) % 4])); \
+        if ((i) >= 1 && (i) <= 16) msg[((i) + 3) % 4] = vsha1su1q_u32(msg[((i) + 3) % 4], msg[((i) + 2) % 4]); \
+        if ((i) <= 15) msg[(i) % 4] = vsha1su0q_u32(msg[(i) % 4], msg[((i) + 1) % 4], msg[((i) + 2) % 4]); \
+    } while (0)
+
+CORE_SHA1_ARMV8_TARGET
+static void compress_armv8(uint32_t state[5], const uint8_t *blocks, size_t count) {
+    uint32x4_t abcd = vld1q_u32(state);
+    uint32_t e0 = state[4];
+    uint32x4_t msg[4];
+    uint32x4_t tmp[2];
+    uint32_t e[2];
+
+    for (; count > 0; count--, blocks += CORE_SHA1_BLOCK_LENGTH) {
+        uint32x4_t abcd_save = abcd;
+        uint32_t e0_save = e0;
+
+        for (int i = 0; i < 4; i++) {
+            msg[i] = vreinterpretq_u32_u8(vrev32q_u8(vld1q_u8(blocks + i * 16)));
+        }
+        tmp[0] = vaddq_u32(msg[0], vdupq_n_u32(sha1_k[0]));
+        tmp[1] = vaddq_u32(msg[1], vdupq_n_u32(sha1_k[0]));
+        e[0] = e0;
+
+        ARMV8_STEP(0, vsha1cq_u32);  ARMV8_STEP(1, vsha1cq_u32);  ARMV8_STEP(2, vsha1cq_u32);
+        ARMV8_STEP(3, vsha1cq_u32);  ARMV8_STEP(4, vsha1cq_u32);  ARMV8_STEP(5, vsha1pq_u32);
+        ARMV8_STEP(6, vsha1pq_u32);  ARMV8_STEP(7, vsha1pq_u32);  ARMV8_STEP(8, vsha1pq_u32);
+        ARMV8_STEP(9, vsha1pq_u32);  ARMV8_STEP(10, vsha1mq_u32); ARMV8_STEP(11, vsha1mq_u32);
+        ARMV8_STEP(12, vsha1mq_u32); ARMV8_STEP(13, vsha1mq_u32); ARMV8_STEP(14, vsha1mq_u32);
+        ARMV8_STEP(15, vsha1pq_u32); ARMV8_STEP(16, vsha1pq_u32); ARMV8_STEP(17, vsha1pq_u32);
+        ARMV8_STEP(18, vsha1pq_u32); ARMV8_STEP(19, vsha1pq_u32);
+
+        e0 = e[0] + e0_save;
+        abcd = vaddq_u32(abcd, abcd_save);
+    }
+
+    vst1q_u32(state, abcd);
+    state[4] = e0;
+}
+
+static bool cpu_has_armv8_sha(void) {
+#if defined(__linux__)
+    return (getauxval(AT_HWCAP) & HWCAP_SHA1) != 0;
+#elif defined(__ARM_FEATURE_SHA2) || defined(__ARM_FEATURE_CRYPTO)
+    return true; // The compile target already guarantees it (e.g. every Apple arm64 CPU)
+#else
+    return false;
+#endif
+}
+#endif
+
+// Multi-buffer kernels: lane l of every vector belongs to buffer l, state is [word][lane]
+#define CORE_SHA1_MAX_LANES 16
+typedef void (*CoreSha1MultiCompressFn)(uint32_t state[5][CORE_SHA1_MAX_LANES], const uint8_t *const *blocks, size_t count);
+
+#if defined(CORE_SHA1_X86)
+#define AVX2_TARGET __attribute__((target("avx2")))
+#define AVX512_TARGET __attribute__((target("avx512f,avx2")))
+
+AVX2_TARGET
+static inline __m256i avx2_rotl(__m256i x, int n) {
+    return _mm256_or_si256(_mm256_slli_epi32(x, n), _mm256_srli_epi32(x, 32 - n));
+}
+
+// Turns 8 rows of 8 words (one row per lane) into 8 vectors of one word for every lane
+AVX2_TARGET
+static inline void avx2_transpose8(__m256i r[8]) {
+    __m256i t0 = _mm256_unpacklo_epi32(r[0], r[1]);
+    __m256i t1 = _mm256_unpackhi_epi32(r[0], r[1]);
+    __m256i t2 = _mm256_unpacklo_epi32(r[2], r[3]);
+    __m256i t3 = _mm256_unpackhi_epi32(r[2], r[3]);
+    __m256i t4 = _mm256_unpacklo_epi32(r[4], r[5]);
+    __m256i t5 = _mm256_unpackhi_epi32(r[4], r[5]);
+    __m256i t6 = _mm256_unpacklo_epi32(r[6], r[7]);
+    __m256i t7 = _mm256_unpackhi_epi32(r[6], r[7]);
+    __m256i u0 = _mm256_unpacklo_epi64(t0, t2);
+    __m256i u1 = _mm256_unpackhi_epi64(t0, t2);
+    __m256i u2 = _mm256_unpacklo_epi64(t1, t3);
+    __m256i u3 = _mm256_unpackhi_epi64(t1, t3);
+    __m256i u4 = _mm256_unpacklo_epi64(t4, t6);
+    __m256i u5 = _mm256_unpackhi_epi64(t4, t6);
+    __m256i u6 = _mm256_unpacklo_epi64(t5, t7);
+    __m256i u7 = _mm256_unpackhi_epi64(t5, t7);
+    r[0] = _mm256_permute2x128_si256(u0, u4, 0x20);
+    r[1] = _mm256_permute2x128_si256(u1, u5, 0x20);
+    r[2] = _mm256_permute2x128_si256(u2, u6, 0x20);
+    r[3] = _mm256_permute2x128_si256(u3, u7, 0x20);
+    r[4] = _mm256_permute2x128_si256(u0, u4, 0x31);
+    r[5] = _mm256_permute2x128_si256(u1, u5, 0x31);
+    r[6] = _mm256_permute2x128_si256(u2, u6, 0x31);
+    r[7] = _mm256_permute2x128_si256(u3, u7, 0x31);
+}
+
+// Loads 8 message words (half a block) of lanes first..first+7, byte swapped into one vector per word
+AVX2_TARGET
+static inline void avx2_load_words(__m256i w[8], const uint8_t *const *blocks, size_t first, size_t offset) {
+    const __m256i byte_swap = _mm256_setr_epi8(3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12,
+                                               3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12);
+    for (size_t l = 0; l < 8; l++) {
+        w[l] = _mm256_loadu_si256((const __m256i *)(blocks[first + l] + offset));
+    }
+    avx2_transpose8(w);
+    for (size_t l = 0; l < 8; l++) {
+        w[l] = _mm256_shuffle_epi8(w[l], byte_swap);
+    }
+}
+
+#define AVX2_ROUND(i, f) do { \
+        if ((i) >= 16) { \
+            w[(i) & 15] = avx2_rotl(_mm256_xor_si256(_mm256_xor_si256(w[((i) + 13) & 15], w[((i) + 8) & 15]), \
+                                                     _mm256_xor_si256(w[((i) + 2) & 15], w[(i) & 15])), 1); \
+        } \
+        __m256i temp = _mm256_add_epi32(_mm256_add_epi32(avx2_rotl(a, 5), (f)), \
+                                        _mm256_add_epi32(_mm256_add_epi32(e, k), w[(i) & 15])); \
+        e = d; d = c; c = avx2_rotl(b, 30); b = a; a = temp; \
+    } while (0)
+
+AVX2_TARGET
+static void compress_avx2_x8(uint32_t state[5][CORE_SHA1_MAX_LANES], const uint8_t *const *blocks, size_t count) {
+    __m256i a = _mm256_loadu_si256((const __m256i *)state[0]);
+    __m256i b = _mm256_loadu_si256((const __m256i *)state[1]);
+    __m256i c = _mm256_loadu_si256((const __m256i *)state[2]);
+    __m256i d = _mm256_loadu_si256((const __m256i *)state[3]);
+    __m256i e = _mm256_loadu_si256((const __m256i *)state[4]);
+
+    for (size_t n = 0; n < count; n++) {
+        __m256i w[16];
+        avx2_load_words(w, blocks, 0, n * CORE_SHA1_BLOCK_LENGTH);
+        avx2_load_words(w + 8, blocks, 0, n * CORE_SHA1_BLOCK_LENGTH + 32);
+        __m256i sa = a, sb = b, sc = c, sd = d, se = e;
+
+        __m256i k = _mm256_set1_epi32((int)sha1_k[0]);
+        for (int i = 0; i < 20; i++) AVX2_ROUND(i, _mm256_or_si256(_mm256_and_si256(b, c), _mm256_andnot_si256(b, d)));
+        k = _mm256_set1_epi32((int)sha1_k[1]);
+        for (int i = 20; i < 40; i++) AVX2_ROUND(i, _mm256_xor_si256(_mm256_xor_si256(b, c), d));
+        k = _mm256_set1_epi32((int)sha1_k[2]);
+        for (int i = 40; i < 60; i++) AVX2_ROUND(i, _mm256_or_si256(_mm256_and_si256(b, c), _mm256_and_si256(d, _mm256_or_si256(b, c))));
+        k = _mm256_set1_epi32((int)sha1_k[3]);
+        for (int i = 60; i < 80; i++) AVX2_ROUND(i, _mm256_xor_si256(_mm256_xor_si256(b, c), d));
+
+        a = _mm256_add_epi32(a, sa);
+        b = _mm256_add_epi32(b, sb);
+        c = _mm256_add_epi32(c, sc);
+        d = _mm256_add_epi32(d, sd);
+        e = _mm256_add_epi32(e, se);
+    }
+
+    _mm256_storeu_si256((__m256i *)state[0], a);
+    _mm256_storeu_si256((__m256i *)state[1], b);
+    _mm256_storeu_si256((__m256i *)state[2], c);
+    _mm256_storeu_si256((__m256i *)state[3], d);
+    _mm256_storeu_si256((__m256i *)state[4], e);
+}
+
+// AVX-512 rotates natively, and ternary logic does each round function in one instruction
+#define AVX512_ROUND(i, logic) do { \
+        if ((i) >= 16) { \
+            __m512i three = _mm512_ternarylogic_epi32(w[((i) + 13) & 15], w[((i) + 8) & 15], w[((i) + 2) & 15], 0x96); \
+            w[(i) & 15] = _mm512_rol_epi32(_mm512_xor_si512(three, w[(i) & 15]), 1); \
+        } \
+        __m512i temp = _mm512_add_epi32(_mm512_add_epi32(_mm512_rol_epi32(a, 5), _mm512_ternarylogic_epi32(b, c, d, logic)), \
+                                        _mm512_add_epi32(_mm512_add_epi32(e, k), w[(i) & 15])); \
+        e = d; d = c; c = _mm512_rol_epi32(b, 30); b = a; a = temp; \
+    } while (0)
+
+AVX512_TARGET
+static void compress_avx512_x16(uint32_t state[5][CORE_SHA1_MAX_LANES], const uint8_t *const *blocks, size_t count) {
+    __m512i a = _mm512_loadu_si512(state[0]);
+    __m512i b = _mm512_loadu_si512(state[1]);
+    __m512i c = _mm512_loadu_si512(state[2]);
+    __m512i d = _mm512_loadu_si512(state[3]);
+    __m512i e = _mm512_loadu_si512(state[4]);
+
+    for (size_t n = 0; n < count; n++) {
+        // Two 8x8 transposes per half block, lanes 0-7 end up in the low half, 8-15 in the high half
+        __m512i w[16];
+        for (size_t half = 0; half < 2; half++) {
+            __m256i low[8];
+            __m256i high[8];
+            avx2_load_words(low, blocks, 0, n * CORE_SHA1_BLOCK_LENGTH + half * 32);
+            avx2_load_words(high, blocks, 8, n * CORE_SHA1_BLOCK_LENGTH + half * 32);
+            for (size_t t = 0; t < 8; t++) {
+                w[half * 8 + t] = _mm512_inserti64x4(_mm512_castsi256_si512(low[t]), high[t], 1);
+            }
+        }
+        __m512i sa = a, sb = b, sc = c, sd = d, se = e;
+
+        __m512i k = _mm512_set1_epi32((int)sha1_k[0]);
+        for (int i = 0; i < 20; i++) AVX512_ROUND(i, 0xCA); // (b & c) | (~b & d)
+        k = _mm512_set1_epi32((int)sha1_k[1]);
+        for (int i = 20; i < 40; i++) AVX512_ROUND(i, 0x96); // b ^ c ^ d
+        k = _mm512_set1_epi32((int)sha1_k[2]);
+        for (int i = 40; i < 60; i++) AVX512_ROUND(i, 0xE8); // Majority
+        k = _mm512_set1_epi32((int)sha1_k[3]);
+        for (int i = 60; i < 80; i++) AVX512_ROUND(i, 0x96);
+
+        a = _mm512_add_epi32(a, sa);
+        b = _mm512_add_epi32(b, sb);
+        c = _mm512_add_epi32(c, sc);
+        d = _mm512_add_epi32(d, sd);
+        e = _mm512_add_epi32(e, se);
+    }
+
+    _mm512_storeu_si512(state[0], a);
+    _mm512_storeu_si512(state[1], b);
+    _mm512_storeu_si512(state[2], c);
+    _mm512_storeu_si512(state[3], d);
+    _mm512_storeu_si512(state[4], e);
+}
+
+static uint64_t read_xcr0(void) {
+    uint32_t eax, edx;
+    __asm__ volatile("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+    return ((uint64_t)edx << 32) | eax;
+}
+
+// The CPU has to support the instructions, and the OS has to save the wider registers
+static bool cpu_has_avx(bool avx512) {
+    unsigned int eax, ebx, ecx, edx;
+    if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx)) return false;
+    if (!(ecx & bit_OSXSAVE) || !(ecx & bit_AVX)) return false;
+    uint64_t needed = avx512 ? 0xE6 : 0x6; // XMM/YMM state, plus opmask/ZMM state for AVX-512
+    if ((read_xcr0() & needed) != needed) return false;
+    if (!__get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx)) return false;
+    return (ebx & bit_AVX2) != 0 && (!avx512 || (ebx & bit_AVX512F) != 0);
+}
+#endif
+
+typedef struct {
+    CoreSha1CompressFn compress;
+    CoreSha1MultiCompressFn multi_compress; // NULL: CoreSha1_hash_many hashes one buffer at a time
+    size_t lanes;
+} CoreSha1Kernels;
+
+static CoreSha1Kernels active_kernels = { compress_scalar, NULL, 1 };
+static CoreSha1Implementation active_implementation = CORE_SHA1_IMPL_SCALAR;
+static pthread_once_t detect_once = PTHREAD_ONCE_INIT;
+
+static bool kernels_for(CoreSha1Implementation implementation, CoreSha1Kernels *out) {
+    *out = (CoreSha1Kernels){ compress_scalar, NULL, 1 };
+    switch (implementation) {
+        case CORE_SHA1_IMPL_SCALAR:
+            return true;
+#if defined(CORE_SHA1_X86)
+        case CORE_SHA1_IMPL_SHA_NI:
+            out->compress = compress_sha_ni;
+            return cpu_has_sha_ni();
+        case CORE_SHA1_IMPL_AVX2:
+            out->multi_compress = compress_avx2_x8;
+            out->lanes = 8;
+            return cpu_has_avx(false);
+        case CORE_SHA1_IMPL_AVX512:
+            out->multi_compress = compress_avx512_x16;
+            out->lanes = 16;
+            return cpu_has_avx(true);
+#endif
+#if defined(CORE_SHA1_HAVE_ARMV8)
+        case CORE_SHA1_IMPL_ARMV8:
+            out->compress = compress_armv8;
+            return cpu_has_armv8_sha();
+#endif
+        default:
+            return false;
+    }
+}
+
+static void detect_implementation(void) {
+    // Single stream and multi-buffer are picked separately: on wide vector units running 8-16 generic
+    // SHA-1s side by side beats the SHA instructions, which only speed up one stream
+    static const CoreSha1Implementation single[] = { CORE_SHA1_IMPL_SHA_NI, CORE_SHA1_IMPL_ARMV8 };
+    static const CoreSha1Implementation multi[] = { CORE_SHA1_IMPL_AVX512, CORE_SHA1_IMPL_AVX2 };
+    CoreSha1Kernels kernels;
+    for (size_t i = 0; i < sizeof(single) / sizeof(single[0]); i++) {
+        if (kernels_for(single[i], &kernels)) {
+            active_kernels.compress = kernels.compress;
+            active_implementation = single[i];
+            break;
+        }
+    }
+    for (size_t i = 0; i < sizeof(multi) / sizeof(multi[0]); i++) {
+        if (kernels_for(multi[i], &kernels)) {
+            active_kernels.multi_compress = kernels.multi_compress;
+            active_kernels.lanes = kernels.lanes;
+            if (active_implementation == CORE_SHA1_IMPL_SCALAR) active_implementation = multi[i];
+            break;
+        }
+    }
+}
+
+static const CoreSha1Kernels *get_kernels(void) {
+    pthread_once(&detect_once, detect_implementation);
+    return &active_kernels;
+}
+
+bool CoreSha1_is_supported(CoreSha1Implementation implementation) {
+    CoreSha1Kernels kernels;
+    return implementation == CORE_SHA1_IMPL_AUTO || kernels_for(implementation, &kernels);
+}
+
+bool CoreSha1_set_implementation(CoreSha1Implementation implementation) {
+    pthread_once(&detect_once, detect_implementation);
+    if (implementation == CORE_SHA1_IMPL_AUTO) {
+        active_kernels = (CoreSha1Kernels){ compress_scalar, NULL, 1 };
+        active_implementation = CORE_SHA1_IMPL_SCALAR;
+        detect_implementation();
+        return true;
+    }
+
+    CoreSha1Kernels kernels;
+    if (!kernels_for(implementation, &kernels)) return false;
+    active_kernels = kernels;
+    active_implementation = implementation;
+    return true;
+}
+
+CoreSha1Implementation CoreSha1_get_implementation(void) {
+    pthread_once(&detect_once, detect_implementation);
+    return active_implementation;
+}
+
+void CoreSha1_init(CoreSha1 *sha) {
+    sha->state[0] = 0x67452301;
+    sha->state[1] = 0xEFCDAB89;
+    sha->state[2] = 0x98BADCFE;
+    sha->state[3] = 0x10325476;
+    sha->state[4] = 0xC3D2E1F0;
+    sha->length = 0;
+    sha->buffer_used = 0;
+}
+
+void CoreSha1_update(CoreSha1 *sha, const void *data, size_t size) {
+    const uint8_t *bytes = (const uint8_t *)data;
+    if (size == 0) return;
+    CoreSha1CompressFn compress = get_kernels()->compress;
+    sha->length += size;
+
+    // Top up a partial block first
+    if (sha->buffer_used > 0) {
+        size_t take = CORE_SHA1_BLOCK_LENGTH - sha->buffer_used;
+        if (take > size) take = size;
+        memcpy(sha->buffer + sha->buffer_used, bytes, take);
+        sha->buffer_used += take;
+        bytes += take;
+        size -= take;
+        if (sha->buffer_used < CORE_SHA1_BLOCK_LENGTH) return;
+        compress(sha->state, sha->buffer, 1);
+        sha->buffer_used = 0;
+    }
+
+    // Whole blocks go straight from the caller's memory
+    size_t blocks = size / CORE_SHA1_BLOCK_LENGTH;
+    if (blocks > 0) {
+        compress(sha->state, bytes, blocks);
+        bytes += blocks * CORE_SHA1_BLOCK_LENGTH;
+        size -= blocks * CORE_SHA1_BLOCK_LENGTH;
+    }
+
+    if (size > 0) {
+        memcpy(sha->buffer, bytes, size);
+        sha->buffer_used = size;
+    }
+}
+
+void CoreSha1_final(CoreSha1 *sha, uint8_t out[CORE_SHA1_DIGEST_LENGTH]) {
+    CoreSha1CompressFn compress = get_kernels()->compress;
+    uint64_t bit_length = sha->length * 8;
+
+    // Padding: 0x80, zeros, then the length in bits as a big-endian 64-bit number
+    sha->buffer[sha->buffer_used++] = 0x80;
+    if (sha->buffer_used > CORE_SHA1_BLOCK_LENGTH - 8) {
+        memset(sha->buffer + sha->buffer_used, 0, CORE_SHA1_BLOCK_LENGTH - sha->buffer_used);
+        compress(sha->state, sha->buffer, 1);
+        sha->buffer_used = 0;
+    }
+    memset(sha->buffer + sha->buffer_used, 0, CORE_SHA1_BLOCK_LENGTH - 8 - sha->buffer_used);
+    for (int i = 0; i < 8; i++) {
+        sha->buffer[CORE_SHA1_BLOCK_LENGTH - 1 - i] = (uint8_t)(bit_length >> (i * 8));
+    }
+    compress(sha->state, sha->buffer, 1);
+
+    for (int i = 0; i < 5; i++) {
+        out[i * 4 + 0] = (uint8_t)(sha->state[i] >> 24);
+        out[i * 4 + 1] = (uint8_t)(sha->state[i] >> 16);
+        out[i * 4 + 2] = (uint8_t)(sha->state[i] >> 8);
+        out[i * 4 + 3] = (uint8_t)sha->state[i];
+    }
+}
+
+void CoreSha1_hash(const void *data, size_t size, uint8_t out[CORE_SHA1_DIGEST_LENGTH]) {
+    CoreSha1 sha;
+    CoreSha1_init(&sha);
+    CoreSha1_update(&sha, data, size);
+    CoreSha1_final(&sha, out);
+}
+
+// Hashes up to lanes buffers with one multi-buffer kernel, unused lanes just repeat buffer 0
+static void hash_lanes(const CoreSha1Kernels *kernels, const uint8_t *const *buffers, size_t used, size_t length,
+                       uint8_t (*out)[CORE_SHA1_DIGEST_LENGTH]) {
+    static const uint32_t initial[5] = { 0x67452301, 0xEFCDAB89, 0x98BADCFE, 0x10325476, 0xC3D2E1F0 };
+    uint32_t state[5][CORE_SHA1_MAX_LANES];
+    const uint8_t *blocks[CORE_SHA1_MAX_LANES];
+    for (size_t l = 0; l < kernels->lanes; l++) {
+        blocks[l] = buffers[l < used ? l : 0];
+        for (int i = 0; i < 5; i++) {
+            state[i][l] = initial[i];
+        }
+    }
+
+    size_t full_blocks = length / CORE_SHA1_BLOCK_LENGTH;
+    kernels->multi_compress(state, blocks, full_blocks);
+
+    // Every lane has the same length, so they all need the same padding
+    uint8_t tail[CORE_SHA1_MAX_LANES][2 * CORE_SHA1_BLOCK_LENGTH];
+    size_t rest = length % CORE_SHA1_BLOCK_LENGTH;
+    size_t tail_blocks = rest + 9 > CORE_SHA1_BLOCK_LENGTH ? 2 : 1;
+    size_t tail_length = tail_blocks * CORE_SHA1_BLOCK_LENGTH;
+    uint64_t bit_length = (uint64_t)length * 8;
+    for (size_t l = 0; l < kernels->lanes; l++) {
+        memcpy(tail[l], blocks[l] + full_blocks * CORE_SHA1_BLOCK_LENGTH, rest);
+        tail[l][rest] = 0x80;
+        memset(tail[l] + rest + 1, 0, tail_length - rest - 1);
+        for (int i = 0; i < 8; i++) {
+            tail[l][tail_length - 1 - i] = (uint8_t)(bit_length >> (i * 8));
+        }
+        blocks[l] = tail[l];
+    }
+    kernels->multi_compress(state, blocks, tail_blocks);
+
+    for (size_t l = 0; l < used; l++) {
+        for (int i = 0; i < 5; i++) {
+            out[l][i * 4 + 0] = (uint8_t)(state[i][l] >> 24);
+            out[l][i * 4 + 1] = (uint8_t)(state[i][l] >> 16);
+            out[l][i * 4 + 2] = (uint8_t)(state[i][l] >> 8);
+            out[l][i * 4 + 3] = (uint8_t)state[i][l];
+        }
+    }
+}
+
+void CoreSha1_hash_many(const uint8_t *const *buffers, size_t length, size_t count,
+                        uint8_t (*out)[CORE_SHA1_DIGEST_LENGTH]) {
+    const CoreSha1Kernels *kernels = get_kernels();
+    if (!kernels->multi_compress) {
+        for (size_t i = 0; i < count; i++) {
+            CoreSha1_hash(buffers[i], length, out[i]);
+        }
+        return;
+    }
+
+    for (size_t first = 0; first < count; first += kernels->lanes) {
+        size_t used = count - first < kernels->lanes ? count - first : kernels->lanes;
+        hash_lanes(kernels, buffers + first, used, length, out + first);
+    }
+}
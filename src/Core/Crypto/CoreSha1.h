@@ -0,0 +1,45 @@
+#ifndef CORE_SHA1_H
+#define CORE_SHA1_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+// SHA-1 with a portable implementation and hardware kernels (x86 SHA-NI, ARMv8 SHA),
+// the fastest one the CPU supports is picked at runtime.
+// CoreSha1_hash_many hashes several equal-sized buffers at once (e.g. pieces), one buffer per SIMD lane
+// (AVX2: 8, AVX-512: 16), or one by one with the single stream kernel when there are no wide vectors.
+
+#define CORE_SHA1_DIGEST_LENGTH 20
+#define CORE_SHA1_BLOCK_LENGTH 64
+
+typedef enum {
+    CORE_SHA1_IMPL_AUTO,   // Fastest supported single stream and multi-buffer kernels
+    CORE_SHA1_IMPL_SCALAR, // Portable C, always available
+    CORE_SHA1_IMPL_SHA_NI, // x86 SHA extensions
+    CORE_SHA1_IMPL_ARMV8,  // ARMv8 cryptography extensions
+    CORE_SHA1_IMPL_AVX2,   // Scalar single stream, 8 lane AVX2 for CoreSha1_hash_many
+    CORE_SHA1_IMPL_AVX512  // Scalar single stream, 16 lane AVX-512 for CoreSha1_hash_many
+} CoreSha1Implementation;
+
+typedef struct {
+    uint32_t state[5];
+    uint64_t length; // Total bytes hashed so far
+    uint8_t buffer[CORE_SHA1_BLOCK_LENGTH]; // Partial block waiting for more data
+    size_t buffer_used;
+} CoreSha1;
+
+void CoreSha1_init(CoreSha1 *sha);
+void CoreSha1_update(CoreSha1 *sha, const void *data, size_t size);
+void CoreSha1_final(CoreSha1 *sha, uint8_t out[CORE_SHA1_DIGEST_LENGTH]);
+void CoreSha1_hash(const void *data, size_t size, uint8_t out[CORE_SHA1_DIGEST_LENGTH]); // One-shot
+// out[i] is the digest of the length bytes at buffers[i]
+void CoreSha1_hash_many(const uint8_t *const *buffers, size_t length, size_t count,
+                        uint8_t (*out)[CORE_SHA1_DIGEST_LENGTH]);
+
+// Mostly for tests and benchmarks: force a kernel, fails if the CPU doesn't support it. Not thread-safe.
+bool CoreSha1_set_implementation(CoreSha1Implementation implementation);
+CoreSha1Implementation CoreSha1_get_implementation(void); // With AUTO: the single stream kernel, unless that's scalar
+bool CoreSha1_is_supported(CoreSha1Implementation implementation);
+
+#endif // CORE_SHA1_H
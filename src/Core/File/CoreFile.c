@@ -1,5 +1,9 @@
 #include "CoreFile.h"
 
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+
 char* getFileName(const char* path) {
     const char* lastSlash = strrchr(path, '/');
     if (lastSlash != NULL) {
@@ -103,3 +107,62 @@ void CoreFile_flush(CoreFile *file) {
     if (!file || !file->file) return;
     fflush(file->file);
 }
+
+#define COREFILE_WRITEV_BATCH 64 // Well below IOV_MAX everywhere
+
+// Writes all segments, writev may stop anywhere so the batch is rebuilt from where it stopped
+static bool write_all_segments(int fd, const struct iovec *segments, size_t count) {
+    size_t index = 0;
+    size_t offset = 0; // Bytes of segments[index] already written
+    while (index < count) {
+        struct iovec batch[COREFILE_WRITEV_BATCH];
+        int batch_count = 0;
+        for (size_t i = index; i < count && batch_count < COREFILE_WRITEV_BATCH; i++) {
+            size_t skip = i == index ? offset : 0;
+            batch[batch_count].iov_base = (char *)segments[i].iov_base + skip;
+            batch[batch_count].iov_len = segments[i].iov_len - skip;
+            batch_count++;
+        }
+
+        ssize_t written = writev(fd, batch, batch_count);
+        if (written < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+
+        size_t remaining = (size_t)written;
+        while (index < count && remaining >= segments[index].iov_len - offset) {
+            remaining -= segments[index].iov_len - offset;
+            offset = 0;
+            index++;
+        }
+        offset += remaining;
+    }
+    return true;
+}
+
+bool CoreFile_write_atomic(const char *path, const struct iovec *segments, size_t count) {
+    if (!path || (!segments && count > 0)) return false;
+
+    size_t path_len = strlen(path);
+    char *temp_path = malloc(path_len + sizeof(".tmp"));
+    if (!temp_path) return false;
+    memcpy(temp_path, path, path_len);
+    memcpy(temp_path + path_len, ".tmp", sizeof(".tmp"));
+
+    int fd = open(temp_path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        free(temp_path);
+        return false;
+    }
+
+    // The data has to be on disk before the rename, or a crash could leave an empty file behind
+    bool ok = write_all_segments(fd, segments, count) && fsync(fd) == 0;
+    ok = close(fd) == 0 && ok;
+    ok = ok && rename(temp_path, path) == 0;
+    if (!ok) {
+        unlink(temp_path);
+    }
+    free(temp_path);
+    return ok;
+}
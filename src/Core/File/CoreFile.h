@@ -6,6 +6,7 @@
 #include <stdint.h>
 #include <string.h>
 #include <stdbool.h>
+#include <sys/uio.h>
 
 // We use a custom abstraction on top of the standard C file I/O functions
 // This allows for easier piece management later.
@@ -36,4 +37,8 @@ void CoreFile_read_chunk(CoreFile *file, void *buffer, size_t size, uint64_t off
 void CoreFile_preallocate(CoreFile *file, uint64_t size);
 void CoreFile_flush(CoreFile *file);
 
+// Writes the segments to a temporary file next to path, syncs it and renames it over path.
+// Readers see either the old or the new contents, never a partial file.
+bool CoreFile_write_atomic(const char *path, const struct iovec *segments, size_t count);
+
 #endif //COREFILE_H
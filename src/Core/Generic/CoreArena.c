@@ -0,0 +1,112 @@
+#include "CoreArena.h"
+#include <stdlib.h>
+#include <stdint.h>
+
+struct CoreArenaBlock {
+    CoreArenaBlock *next;
+    size_t capacity;
+    size_t used;
+    max_align_t data[]; // max_align_t keeps the first allocation suitably aligned
+};
+
+#define CORE_ARENA_ALIGNMENT _Alignof(max_align_t)
+
+static CoreArenaBlock *block_create(size_t capacity) {
+    CoreArenaBlock *block = (CoreArenaBlock *)malloc(sizeof(CoreArenaBlock) + capacity);
+    if (block == NULL) {
+        return NULL; // Memory allocation failed
+    }
+    block->next = NULL;
+    block->capacity = capacity;
+    block->used = 0;
+    return block;
+}
+
+CoreArena *CoreArena_create(size_t block_size) {
+    CoreArena *arena = (CoreArena *)malloc(sizeof(CoreArena));
+    if (arena == NULL) {
+        return NULL;
+    }
+    arena->blocks = NULL; // The first block is created on the first allocation
+    arena->block_size = block_size > 0 ? block_size : CORE_ARENA_DEFAULT_BLOCK_SIZE;
+    arena->used = 0;
+    return arena;
+}
+
+void CoreArena_destroy(CoreArena *arena) {
+    if (arena == NULL) {
+        return;
+    }
+    CoreArenaBlock *block = arena->blocks;
+    while (block != NULL) {
+        CoreArenaBlock *next = block->next;
+        free(block);
+        block = next;
+    }
+    free(arena);
+}
+
+void *CoreArena_alloc(CoreArena *arena, size_t size) {
+    if (arena == NULL) {
+        return NULL;
+    }
+
+    // Round up, so the next allocation stays aligned as well
+    size = (size + CORE_ARENA_ALIGNMENT - 1) & ~(CORE_ARENA_ALIGNMENT - 1);
+    if (size == 0) {
+        size = CORE_ARENA_ALIGNMENT;
+    }
+
+    CoreArenaBlock *block = arena->blocks;
+    if (block == NULL || block->capacity - block->used < size) {
+        if (size > arena->block_size && block != NULL) {
+            // Oversized allocation, give it a block of its own behind the head so the
+            // remaining space in the head block isn't wasted
+            CoreArenaBlock *big = block_create(size);
+            if (big == NULL) {
+                return NULL;
+            }
+            big->used = size;
+            big->next = block->next;
+            block->next = big;
+            arena->used += size;
+            return big->data;
+        }
+
+        block = block_create(size > arena->block_size ? size : arena->block_size);
+        if (block == NULL) {
+            return NULL;
+        }
+        block->next = arena->blocks;
+        arena->blocks = block;
+    }
+
+    void *ptr = (unsigned char *)block->data + block->used;
+    block->used += size;
+    arena->used += size;
+    return ptr;
+}
+
+void CoreArena_reset(CoreArena *arena) {
+    if (arena == NULL || arena->blocks == NULL) {
+        return;
+    }
+
+    if (arena->blocks->next != NULL) {
+        // The last round needed several blocks, replace them with one block that fits all of it,
+        // so a steady workload stops touching malloc after the first round
+        size_t capacity = arena->used > arena->block_size ? arena->used : arena->block_size;
+        CoreArenaBlock *block = arena->blocks;
+        while (block != NULL) {
+            CoreArenaBlock *next = block->next;
+            free(block);
+            block = next;
+        }
+        arena->blocks = block_create(capacity); // NULL is fine, the next allocation retries
+    }
+
+    if (arena->blocks != NULL) {
+        arena->blocks->used = 0;
+    }
+    arena->used = 0;
+}
@@ -0,0 +1,26 @@
+#ifndef CORE_ARENA_H
+#define CORE_ARENA_H
+
+#include <stddef.h>
+#include <stdbool.h>
+
+// Bump allocator: allocations are a pointer increment, and everything is released at once.
+// There is no way to free a single allocation.
+
+#define CORE_ARENA_DEFAULT_BLOCK_SIZE (64 * 1024)
+
+typedef struct CoreArenaBlock CoreArenaBlock;
+
+typedef struct {
+    CoreArenaBlock *blocks; // Newest block first, allocations come from the head
+    size_t block_size;      // Size of newly added blocks (bigger allocations get their own block)
+    size_t used;            // Bytes handed out since the last reset
+} CoreArena;
+
+CoreArena *CoreArena_create(size_t block_size); // 0 picks CORE_ARENA_DEFAULT_BLOCK_SIZE
+void CoreArena_destroy(CoreArena *arena);
+
+void *CoreArena_alloc(CoreArena *arena, size_t size);
+void CoreArena_reset(CoreArena *arena); // Releases all allocations, but keeps the memory around for reuse
+
+#endif // CORE_ARENA_H
@@ -101,11 +101,11 @@ CoreNetworking_bandwith_test_run(
                 }
                 else {
                     double t_connect = 0.0, t_firstbyte = 0.0, t_total = 0.0;
-                    double size_download = 0;
+                    curl_off_t size_download = 0;
                     curl_easy_getinfo(easy, CURLINFO_CONNECT_TIME,       &t_connect);
                     curl_easy_getinfo(easy, CURLINFO_STARTTRANSFER_TIME, &t_firstbyte);
                     curl_easy_getinfo(easy, CURLINFO_TOTAL_TIME,         &t_total);
-                    curl_easy_getinfo(easy, CURLINFO_SIZE_DOWNLOAD, &size_download);
+                    curl_easy_getinfo(easy, CURLINFO_SIZE_DOWNLOAD_T, &size_download);
 
                     // Cast size_download to size_t
                     if (size_download < 0) {
@@ -242,3 +242,65 @@ bool CoreNetworking_download_to_file(const CoreNetworkingDownloadOptions *option
     curl_easy_cleanup(easy);
     return true;
 }
+
+typedef struct {
+    CURL *easy;
+    bool ranged;
+    CoreNetworkingDataCallback callback;
+    void *user_data;
+} CoreNetworkingStream;
+
+static size_t write_stream(void *ptr, size_t size, size_t nmemb, void *userdata) {
+    CoreNetworkingStream *stream = userdata;
+    if (stream->ranged) {
+        // A 200 means the server sent the whole file from the start, which isn't what the caller expects
+        long code = 0;
+        curl_easy_getinfo(stream->easy, CURLINFO_RESPONSE_CODE, &code);
+        if (code != 206) return 0;
+    }
+    if (!stream->callback(ptr, size * nmemb, stream->user_data)) return 0;
+    return size * nmemb;
+}
+
+bool CoreNetworking_download_stream(const CoreNetworkingDownloadOptions *options, uint64_t range_start,
+                                    CoreNetworkingDataCallback callback, void *user_data) {
+    if (options == NULL || callback == NULL) {
+        fprintf(stderr, "CoreNetworking_download_stream: Invalid arguments\n");
+        return false;
+    }
+
+    CURL *easy = curl_easy_init();
+    if (!easy) {
+        fprintf(stderr, "CoreNetworking_download_stream: curl_easy_init failed\n");
+        return false;
+    }
+
+    CoreNetworkingStream stream = { easy, range_start > 0, callback, user_data };
+    char range[32];
+    if (stream.ranged) {
+        snprintf(range, sizeof(range), "%llu-", (unsigned long long)range_start);
+        curl_easy_setopt(easy, CURLOPT_RANGE, range);
+    }
+
+    curl_easy_setopt(easy, CURLOPT_URL, options->url);
+    if (options->user_agent) {
+        curl_easy_setopt(easy, CURLOPT_USERAGENT, options->user_agent);
+    }
+    curl_easy_setopt(easy, CURLOPT_TIMEOUT, 0L);
+    curl_easy_setopt(easy, CURLOPT_FOLLOWLOCATION, options->follow_redirects ? 1L : 0L);
+    curl_easy_setopt(easy, CURLOPT_WRITEFUNCTION, write_stream);
+    curl_easy_setopt(easy, CURLOPT_WRITEDATA, &stream);
+    curl_easy_setopt(easy, CURLOPT_FAILONERROR, 1L);
+
+    curl_easy_setopt(easy, CURLOPT_NOPROGRESS, 0L);
+    curl_easy_setopt(easy, CURLOPT_XFERINFOFUNCTION, progress_callback);
+    curl_easy_setopt(easy, CURLOPT_XFERINFODATA, NULL);
+
+    CURLcode res = curl_easy_perform(easy);
+    curl_easy_cleanup(easy);
+    if (res != CURLE_OK && res != CURLE_WRITE_ERROR) {
+        // Write errors are the callback aborting, the caller knows why
+        fprintf(stderr, "CoreNetworking_download_stream: curl_easy_perform failed: %s\n", curl_easy_strerror(res));
+    }
+    return res == CURLE_OK;
+}
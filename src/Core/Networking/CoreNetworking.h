@@ -29,6 +29,9 @@ typedef struct {
   bool follow_redirects;
 } CoreNetworkingDownloadOptions;
 
+// Gets every chunk of the body as it arrives, return false to abort the transfer
+typedef bool (*CoreNetworkingDataCallback)(const uint8_t *data, size_t size, void *user_data);
+
 /// Runs a bandwidth test against the given URLs using the provided options.
 /// Options should be an array of CoreNetworkingBandwithTestOptions.
 /// All results are in order of the URLs provided.
@@ -37,4 +40,12 @@ bool CoreNetworking_download_to_file(
     const CoreNetworkingDownloadOptions *options,
     CoreFile *file
 );
+/// Streams the body to callback instead of a file. With range_start > 0 only the bytes from there on are
+/// requested, and the download fails if the server ignores the range. False if it failed or callback aborted.
+bool CoreNetworking_download_stream(
+    const CoreNetworkingDownloadOptions *options,
+    uint64_t range_start,
+    CoreNetworkingDataCallback callback,
+    void *user_data
+);
 #endif //CORENETWORKING_H
@@ -12,6 +12,7 @@ CoreString *CoreString_create(const char *str){
         return NULL; // Memory allocation failed
     }
     strcpy(coreString->str, str);
+    coreString->is_view = false;
     return coreString;
 }
 
@@ -27,21 +28,56 @@ CoreString * CoreString_create_with_length(const char *str, size_t length) {
         return NULL; // Memory allocation failed
     }
     if (length > 0) {
-        strncpy(coreString->str, str, length);
+        memcpy(coreString->str, str, length); // Binary safe, bencode strings can contain NUL bytes
     }
     coreString->str[length] = '\0'; // Null-terminate the string
+    coreString->is_view = false;
     return coreString;
 }
 
+// Views are turned into normal owned strings as soon as something modifies them
+CoreString * CoreString_create_view(const char *str, size_t length) {
+    CoreString *coreString = (CoreString *)malloc(sizeof(CoreString));
+    if (coreString == NULL) {
+        return NULL; // Memory allocation failed
+    }
+    coreString->str = (char *)str;
+    coreString->length = length;
+    coreString->is_view = true;
+    return coreString;
+}
+
+// Copy a view into its own null-terminated buffer, so it can be modified
+static bool detach_view(CoreString *coreString) {
+    if (!coreString->is_view) {
+        return true;
+    }
+
+    char *copy = (char *)malloc(coreString->length + 1);
+    if (copy == NULL) {
+        return false; // Memory allocation failed
+    }
+    memcpy(copy, coreString->str, coreString->length);
+    copy[coreString->length] = '\0';
+    coreString->str = copy;
+    coreString->is_view = false;
+    return true;
+}
+
 void CoreString_destroy(CoreString *coreString){
     if (coreString != NULL) {
-        free(coreString->str);
+        if (!coreString->is_view) {
+            free(coreString->str);
+        }
         free(coreString);
         coreString = NULL; // Set to NULL to avoid dangling pointer
     }
 }
 
 void CoreString_append(CoreString *coreString, const char *str){
+    if (!detach_view(coreString)) {
+        return;
+    }
     size_t newLength = coreString->length + strlen(str);
     coreString->str = (char *)realloc(coreString->str, newLength + 1);
     if (coreString->str != NULL) {
@@ -51,6 +87,9 @@ void CoreString_append(CoreString *coreString, const char *str){
 }
 
 void CoreString_prepend(CoreString *coreString, const char *str){
+    if (!detach_view(coreString)) {
+        return;
+    }
     size_t newLength = coreString->length + strlen(str);
     coreString->str = (char *)realloc(coreString->str, newLength + 1);
     if (coreString->str != NULL) {
@@ -61,7 +100,7 @@ void CoreString_prepend(CoreString *coreString, const char *str){
 }
 
 void CoreString_insert(CoreString *coreString, size_t index, const char *str){
-    if (index > coreString->length) {
+    if (index > coreString->length || !detach_view(coreString)) {
         return;
     }
 
@@ -75,7 +114,7 @@ void CoreString_insert(CoreString *coreString, size_t index, const char *str){
 }
 
 void CoreString_remove(CoreString *coreString, size_t index, size_t length){
-    if (index >= coreString->length) {
+    if (index >= coreString->length || !detach_view(coreString)) {
         return;
     }
 
@@ -88,7 +127,7 @@ void CoreString_remove(CoreString *coreString, size_t index, size_t length){
 }
 
 void CoreString_replace(CoreString *coreString, size_t index, size_t length, const char *str){
-    if (index >= coreString->length) {
+    if (index >= coreString->length || !detach_view(coreString)) {
         return;
     }
 
@@ -107,8 +146,11 @@ void CoreString_replace(CoreString *coreString, size_t index, size_t length, con
 
 void CoreString_clear(CoreString *coreString){
     if (coreString != NULL) {
-        free(coreString->str);
+        if (!coreString->is_view) {
+            free(coreString->str);
+        }
         coreString->str = NULL;
         coreString->length = 0;
+        coreString->is_view = false;
     }
 }
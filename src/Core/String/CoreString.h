@@ -4,15 +4,18 @@
 #include <stddef.h>
 #include <stdlib.h>
 #include <string.h>
+#include <stdbool.h>
 
 typedef struct {
     char *str;
     size_t length;
+    bool is_view; // str points into memory owned by someone else, and is NOT null-terminated
 } CoreString;
 
 
 CoreString *CoreString_create(const char *str);
 CoreString *CoreString_create_with_length(const char *str, size_t length);
+CoreString *CoreString_create_view(const char *str, size_t length); // No copy, the caller keeps str alive
 void CoreString_destroy(CoreString *coreString);
 
 void CoreString_append(CoreString *coreString, const char *str);
@@ -0,0 +1,149 @@
+#include "CoreThreadPool.h"
+#include <stdlib.h>
+#include <pthread.h>
+#include <unistd.h>
+
+typedef struct {
+    CoreThreadPoolJob job;
+    void *argument;
+} CoreThreadPoolEntry;
+
+struct CoreThreadPool {
+    pthread_mutex_t lock;
+    pthread_cond_t has_work; // Signalled when a job is queued or the pool stops
+    pthread_cond_t idle;     // Signalled when the last running job finishes
+
+    // Ring buffer of queued jobs, grows when full
+    CoreThreadPoolEntry *queue;
+    size_t capacity;
+    size_t head;
+    size_t count;
+
+    size_t running; // Jobs taken off the queue but not finished yet
+    bool stopping;
+
+    pthread_t *threads;
+    size_t thread_count;
+};
+
+static void *worker_main(void *argument) {
+    CoreThreadPool *pool = argument;
+    pthread_mutex_lock(&pool->lock);
+    for (;;) {
+        while (pool->count == 0 && !pool->stopping) {
+            pthread_cond_wait(&pool->has_work, &pool->lock);
+        }
+        if (pool->count == 0) break; // Stopping and drained
+
+        CoreThreadPoolEntry entry = pool->queue[pool->head];
+        pool->head = (pool->head + 1) % pool->capacity;
+        pool->count--;
+        pool->running++;
+        pthread_mutex_unlock(&pool->lock);
+
+        entry.job(entry.argument);
+
+        pthread_mutex_lock(&pool->lock);
+        pool->running--;
+        if (pool->count == 0 && pool->running == 0) {
+            pthread_cond_broadcast(&pool->idle);
+        }
+    }
+    pthread_mutex_unlock(&pool->lock);
+    return NULL;
+}
+
+size_t CoreThreadPool_cpu_count(void) {
+    long count = sysconf(_SC_NPROCESSORS_ONLN);
+    return count > 0 ? (size_t)count : 1;
+}
+
+CoreThreadPool *CoreThreadPool_create(size_t thread_count) {
+    if (thread_count == 0) thread_count = CoreThreadPool_cpu_count();
+
+    CoreThreadPool *pool = calloc(1, sizeof(CoreThreadPool));
+    if (!pool) return NULL;
+    pool->capacity = 64;
+    pool->queue = malloc(pool->capacity * sizeof(CoreThreadPoolEntry));
+    pool->threads = malloc(thread_count * sizeof(pthread_t));
+    if (!pool->queue || !pool->threads) {
+        free(pool->queue);
+        free(pool->threads);
+        free(pool);
+        return NULL;
+    }
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->has_work, NULL);
+    pthread_cond_init(&pool->idle, NULL);
+
+    for (size_t i = 0; i < thread_count; i++) {
+        if (pthread_create(&pool->threads[i], NULL, worker_main, pool) != 0) break;
+        pool->thread_count++;
+    }
+    if (pool->thread_count == 0) {
+        CoreThreadPool_destroy(pool);
+        return NULL;
+    }
+    return pool;
+}
+
+void CoreThreadPool_destroy(CoreThreadPool *pool) {
+    if (!pool) return;
+    pthread_mutex_lock(&pool->lock);
+    pool->stopping = true;
+    pthread_cond_broadcast(&pool->has_work);
+    pthread_mutex_unlock(&pool->lock);
+
+    for (size_t i = 0; i < pool->thread_count; i++) {
+        pthread_join(pool->threads[i], NULL);
+    }
+
+    pthread_cond_destroy(&pool->idle);
+    pthread_cond_destroy(&pool->has_work);
+    pthread_mutex_destroy(&pool->lock);
+    free(pool->threads);
+    free(pool->queue);
+    free(pool);
+}
+
+// Doubles the ring, unwrapping it so the jobs start at index 0 again
+static bool grow_queue(CoreThreadPool *pool) {
+    size_t capacity = pool->capacity * 2;
+    CoreThreadPoolEntry *queue = malloc(capacity * sizeof(CoreThreadPoolEntry));
+    if (!queue) return false;
+    for (size_t i = 0; i < pool->count; i++) {
+        queue[i] = pool->queue[(pool->head + i) % pool->capacity];
+    }
+    free(pool->queue);
+    pool->queue = queue;
+    pool->capacity = capacity;
+    pool->head = 0;
+    return true;
+}
+
+bool CoreThreadPool_submit(CoreThreadPool *pool, CoreThreadPoolJob job, void *argument) {
+    if (!pool || !job) return false;
+    pthread_mutex_lock(&pool->lock);
+    if (pool->count == pool->capacity && !grow_queue(pool)) {
+        pthread_mutex_unlock(&pool->lock);
+        return false;
+    }
+    pool->queue[(pool->head + pool->count) % pool->capacity] = (CoreThreadPoolEntry){ job, argument };
+    pool->count++;
+    pthread_cond_signal(&pool->has_work);
+    pthread_mutex_unlock(&pool->lock);
+    return true;
+}
+
+void CoreThreadPool_wait(CoreThreadPool *pool) {
+    if (!pool) return;
+    pthread_mutex_lock(&pool->lock);
+    while (pool->count > 0 || pool->running > 0) {
+        pthread_cond_wait(&pool->idle, &pool->lock);
+    }
+    pthread_mutex_unlock(&pool->lock);
+}
+
+size_t CoreThreadPool_thread_count(const CoreThreadPool *pool) {
+    return pool ? pool->thread_count : 0;
+}
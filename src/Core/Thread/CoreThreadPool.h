@@ -0,0 +1,25 @@
+#ifndef CORE_THREAD_POOL_H
+#define CORE_THREAD_POOL_H
+
+#include <stddef.h>
+#include <stdbool.h>
+
+// Fixed set of worker threads running submitted jobs in FIFO order.
+
+typedef void (*CoreThreadPoolJob)(void *argument);
+
+typedef struct CoreThreadPool CoreThreadPool;
+
+// thread_count 0 uses one thread per online CPU
+CoreThreadPool *CoreThreadPool_create(size_t thread_count);
+// Waits for the queued jobs to finish, then stops the workers
+void CoreThreadPool_destroy(CoreThreadPool *pool);
+
+bool CoreThreadPool_submit(CoreThreadPool *pool, CoreThreadPoolJob job, void *argument);
+// Blocks until every job submitted so far has finished
+void CoreThreadPool_wait(CoreThreadPool *pool);
+size_t CoreThreadPool_thread_count(const CoreThreadPool *pool);
+
+size_t CoreThreadPool_cpu_count(void);
+
+#endif // CORE_THREAD_POOL_H
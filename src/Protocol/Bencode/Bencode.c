@@ -1,6 +1,6 @@
 #include "Bencode.h"
 
-#include <CommonCrypto/CommonDigest.h>
+#include <CoreSha1.h>
 
 /// Create a new BencodeItem of the specified type. NULL is returned if memory allocation fails.
 /// You MUST allocate your own list or dictionary after creating the item.
@@ -11,16 +11,21 @@ BencodeItem * BencodeItem_create(BencodeType type) {
     }
 
     item->type = type;
+    item->flags = 0;
+    item->source_start = 0; // Not parsed, so there is no source span
+    item->source_end = 0;
     return item;
 }
 
+static void destroy_contents(BencodeItem *item);
+
 void free_list(BencodeItem* item) {
     BencodeList* list = item->value.list;
     if (list == NULL) {
         return; // Nothing to free
     }
     for (size_t i = 0; i < list->count; i++) {
-        BencodeItem_destroy(&list->items[i]);
+        destroy_contents(&list->items[i]); // Items are stored inline, so only free what they own
     }
     free(list->items); // Free the array of items
     free(list); // Free the list structure
@@ -44,10 +49,10 @@ void free_dict(BencodeItem* item) {
     item->value.dictionary = NULL;
 }
 
-/// Destroy (and free) a BencodeItem.
-void BencodeItem_destroy(BencodeItem *item) {
-    if (item == NULL) {
-        return; // Nothing to destroy
+// Free everything the item owns, but not the item itself
+static void destroy_contents(BencodeItem *item) {
+    if (item->flags & BENCODE_ITEM_FLAG_ARENA) {
+        return; // Released together with its arena
     }
 
     if (item->type == BENCODE_TYPE_LIST) {
@@ -63,248 +68,589 @@ void BencodeItem_destroy(BencodeItem *item) {
     if (item->type == BENCODE_TYPE_STRING) {
         if (item->value.string != NULL) {
             CoreString_destroy(item->value.string);
+            item->value.string = NULL;
         }
     }
+}
+
+/// Destroy (and free) a BencodeItem.
+void BencodeItem_destroy(BencodeItem *item) {
+    if (item == NULL || (item->flags & BENCODE_ITEM_FLAG_ARENA)) {
+        return; // Nothing to destroy, or it belongs to an arena
+    }
+
+    destroy_contents(item);
 
     free(item); // Free the item itself
     item = NULL; // Set to NULL to avoid dangling pointer
     // Done!
 }
 
-static bool parse_integer(const char *data, size_t size, size_t *pos, BencodeItem *item);
-static bool parse_string(const char *data, size_t size, size_t *pos, BencodeItem *item);
-static BencodeItem *parse_list(const char *data, size_t size, size_t *pos);
-static BencodeItem *parse_dictionary(const char *data, size_t size, size_t *pos);
+// Byte-wise comparison, the way bencode orders dictionary keys (embedded NULs are fine)
+static int compare_bytes(const char *s1, size_t len1, const char *s2, size_t len2) {
+    size_t min_len = len1 < len2 ? len1 : len2;
+    int cmp = min_len > 0 ? memcmp(s1, s2, min_len) : 0;
+    if (cmp != 0) return cmp;
+    return (len1 > len2) - (len1 < len2);  // Compare lengths if prefixes match
+}
 
-static BencodeItem *parse_next(const char *data, size_t size, size_t *pos) {
-    if (*pos >= size) return NULL;
+// Helper function to compare two dictionary keys
+static int compare_keys(const CoreString *key1, const CoreString *key2) {
+    return compare_bytes(key1->str, key1->length, key2->str, key2->length);
+}
 
-    char c = data[*pos];
-    if (c == 'i') {
-        BencodeItem *item = BencodeItem_create(BENCODE_TYPE_INTEGER);
-        if (!item) return NULL;
-        if (!parse_integer(data, size, pos, item)) {
-            BencodeItem_destroy(item);
-            return NULL;
-        }
-        return item;
-    } else if (c >= '0' && c <= '9') {
-        BencodeItem *item = BencodeItem_create(BENCODE_TYPE_STRING);
-        if (!item) return NULL;
-        if (!parse_string(data, size, pos, item)) {
-            BencodeItem_destroy(item);
-            return NULL;
+// Stable merge sort of indices into keys[], so the order of duplicate keys is kept.
+// Doesn't touch any global state, so it's safe to use from multiple threads.
+static bool sort_key_indices(CoreString *const *keys, size_t *indices, size_t count) {
+    if (count < 2) return true;
+
+    size_t *temp = (size_t *)malloc(count * sizeof(size_t));
+    if (!temp) return false;
+
+    size_t *src = indices;
+    size_t *dst = temp;
+    for (size_t width = 1; width < count; width *= 2) {
+        for (size_t lo = 0; lo < count; lo += 2 * width) {
+            size_t mid = lo + width < count ? lo + width : count;
+            size_t hi = lo + 2 * width < count ? lo + 2 * width : count;
+            size_t a = lo, b = mid, out = lo;
+            while (a < mid && b < hi) {
+                dst[out++] = compare_keys(keys[src[b]], keys[src[a]]) < 0 ? src[b++] : src[a++];
+            }
+            while (a < mid) dst[out++] = src[a++];
+            while (b < hi) dst[out++] = src[b++];
         }
-        return item;
-    } else if (c == 'l') {
-        return parse_list(data, size, pos);
-    } else if (c == 'd') {
-        return parse_dictionary(data, size, pos);
-    } else {
-        return NULL; // Invalid type
+        size_t *swap = src;
+        src = dst;
+        dst = swap;
     }
-}
 
-static bool parse_integer(const char *data, size_t size, size_t *pos, BencodeItem *item) {
-    if (*pos >= size || data[*pos] != 'i') return false;
-    (*pos)++; // Skip 'i'
-
-    size_t start = *pos;
-    while (*pos < size && data[*pos] != 'e') {
-        (*pos)++;
+    if (src != indices) {
+        memcpy(indices, src, count * sizeof(size_t));
     }
-    if (*pos == size || data[*pos] != 'e') return false;
-
-    char buffer[64];
-    size_t len = *pos - start;
-    if (len >= sizeof(buffer)) return false;
-    memcpy(buffer, data + start, len);
-    buffer[len] = '\0';
-
-    char *end;
-    item->value.integer = strtoll(buffer, &end, 10);
-    if (end != buffer + len) return false;
-
-    (*pos)++; // Skip 'e'
+    free(temp);
     return true;
 }
 
-static bool parse_string(const char *data, size_t size, size_t *pos, BencodeItem *item) {
-    size_t start = *pos;
-    while (*pos < size && data[*pos] != ':') {
-        (*pos)++;
+/// Sort the keys (and their values) of a dictionary into bencode order.
+/// Parsed dictionaries are always sorted, only call this after building one by hand.
+bool BencodeDictionary_sort(BencodeDictionary *dict) {
+    if (dict == NULL) {
+        return false;
     }
-    if (*pos == size || data[*pos] != ':') return false;
-
-    char buffer[64];
-    size_t len = *pos - start;
-    if (len >= sizeof(buffer)) return false;
-    memcpy(buffer, data + start, len);
-    buffer[len] = '\0';
 
-    char *end;
-    long str_len = strtol(buffer, &end, 10);
-    if (end != buffer + len || str_len < 0 || *pos + 1 + str_len > size) {
+    size_t count = dict->count;
+    size_t *indices = (size_t *)malloc(count * sizeof(size_t));
+    CoreString **keys = (CoreString **)malloc(count * sizeof(CoreString *));
+    BencodeItem **values = (BencodeItem **)malloc(count * sizeof(BencodeItem *));
+    if (count > 0 && (!indices || !keys || !values)) {
+        free(indices);
+        free(keys);
+        free(values);
         return false;
     }
 
-    (*pos)++; // Skip ':'
-    CoreString *str = CoreString_create_with_length(data + *pos, str_len);
-    if (!str) return false;
+    for (size_t i = 0; i < count; i++) indices[i] = i;
+    bool sorted = sort_key_indices(dict->keys, indices, count);
+    if (sorted) {
+        for (size_t i = 0; i < count; i++) {
+            keys[i] = dict->keys[indices[i]];
+            values[i] = dict->values[indices[i]];
+        }
+        if (count > 0) {
+            memcpy(dict->keys, keys, count * sizeof(CoreString *));
+            memcpy(dict->values, values, count * sizeof(BencodeItem *));
+        }
+    }
 
-    item->value.string = str;
-    *pos += str_len;
-    return true;
+    free(indices);
+    free(keys);
+    free(values);
+    return sorted;
 }
 
-static BencodeItem *parse_list(const char *data, size_t size, size_t *pos) {
-    if (*pos >= size || data[*pos] != 'l') return NULL;
-    (*pos)++; // Skip 'l'
-
-    BencodeItem *list_item = BencodeItem_create(BENCODE_TYPE_LIST);
-    if (!list_item) return NULL;
-
-    CoreList *temp_list = CoreList_create(10);
-    if (!temp_list) {
-        BencodeItem_destroy(list_item);
+/// Look up a key that may contain any bytes (NULs included). Binary search, so O(log n).
+/// Keys have to be in bencode order, which the parser guarantees (see BencodeDictionary_sort).
+BencodeItem * BencodeDictionary_get_with_length(const BencodeDictionary *dict, const char *key, size_t key_length) {
+    if (dict == NULL || key == NULL) {
         return NULL;
     }
 
-    while (*pos < size && data[*pos] != 'e') {
-        BencodeItem *item = parse_next(data, size, pos);
-        if (!item) {
-            // Cleanup on error
-            for (size_t i = 0; i < CoreList_size(temp_list); i++) {
-                BencodeItem_destroy((BencodeItem*)CoreList_get(temp_list, i));
-            }
-            CoreList_destroy(temp_list);
-            BencodeItem_destroy(list_item);
-            return NULL;
+    size_t lo = 0;
+    size_t hi = dict->count;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        const CoreString *mid_key = dict->keys[mid];
+        int cmp = compare_bytes(mid_key->str, mid_key->length, key, key_length);
+        if (cmp == 0) {
+            return dict->values[mid];
+        }
+        if (cmp < 0) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
         }
-        CoreList_append(temp_list, item);
     }
+    return NULL;
+}
 
-    if (*pos >= size || data[*pos] != 'e') {
-        // Cleanup if no closing 'e'
-        for (size_t i = 0; i < CoreList_size(temp_list); i++) {
-            BencodeItem_destroy((BencodeItem*)CoreList_get(temp_list, i));
-        }
-        CoreList_destroy(temp_list);
-        BencodeItem_destroy(list_item);
+/// Look up a null-terminated key, see BencodeDictionary_get_with_length.
+BencodeItem * BencodeDictionary_get(const BencodeDictionary *dict, const char *key) {
+    if (key == NULL) {
         return NULL;
     }
-    (*pos)++; // Skip 'e'
+    return BencodeDictionary_get_with_length(dict, key, strlen(key));
+}
 
-    // Create final list structure
-    size_t count = CoreList_size(temp_list);
-    BencodeList *blist = (BencodeList*)malloc(sizeof(BencodeList));
-    if (!blist) {
-        CoreList_destroy(temp_list);
-        BencodeItem_destroy(list_item);
-        return NULL;
+// Children of the containers that are still open, they are moved out in one go once the container closes
+typedef struct {
+    CoreString *key; // NULL for list entries
+    BencodeItem item;
+} BencodeScratchEntry;
+
+#define BENCODE_INLINE_SCRATCH 32
+
+// A list or dictionary that is still open, the parser keeps these on its own stack instead of recursing
+typedef struct {
+    BencodeType type; // BENCODE_TYPE_LIST or BENCODE_TYPE_DICTIONARY
+    size_t base; // First scratch entry belonging to this container
+    size_t source_start;
+    CoreString *key; // Dictionary key waiting for its value
+    CoreString *previous_key; // For the key order check
+    bool needs_sort;
+} BencodeParseFrame;
+
+#define BENCODE_INLINE_FRAMES 16
+
+// Shared by all lazy items of one parse, lives in the arena
+struct BencodeLazySource {
+    const char *data;
+    BencodeParseOptions options;
+};
+
+// State shared by all parse functions
+typedef struct {
+    const char *data;
+    size_t size;
+    size_t pos;
+    BencodeParseOptions options;
+    uint32_t item_flags; // Flags given to every parsed item
+
+    BencodeScratchEntry *scratch;
+    size_t scratch_count;
+    size_t scratch_capacity;
+    BencodeScratchEntry inline_scratch[BENCODE_INLINE_SCRATCH]; // Small documents never hit the heap for this
+
+    BencodeParseFrame *frames;
+    size_t frame_count;
+    size_t frame_capacity;
+    size_t max_depth;
+    BencodeParseFrame inline_frames[BENCODE_INLINE_FRAMES];
+
+    BencodeLazySource *lazy; // Set in lazy mode, nested containers are skipped instead of decoded
+} BencodeParser;
+
+// Allocates from the arena if there is one, otherwise from the heap
+static void *parser_alloc(BencodeParser *parser, size_t size) {
+    if (parser->options.arena) {
+        return CoreArena_alloc(parser->options.arena, size);
     }
+    return malloc(size);
+}
 
-    blist->count = count;
-    blist->items = (BencodeItem*)malloc(count * sizeof(BencodeItem));
-    if (!blist->items) {
-        free(blist);
-        CoreList_destroy(temp_list);
-        BencodeItem_destroy(list_item);
-        return NULL;
+static void parser_free(BencodeParser *parser, void *ptr) {
+    if (!parser->options.arena) {
+        free(ptr);
     }
+}
 
-    for (size_t i = 0; i < count; i++) {
-        blist->items[i] = *(BencodeItem*)CoreList_get(temp_list, i);
+static void parser_destroy_string(BencodeParser *parser, CoreString *str) {
+    if (!parser->options.arena) {
+        CoreString_destroy(str);
     }
+}
 
-    list_item->value.list = blist;
-    CoreList_destroy(temp_list); // Only destroys container, not items
-    return list_item;
+static void parser_destroy_contents(BencodeParser *parser, BencodeItem *item) {
+    if (!parser->options.arena) {
+        destroy_contents(item);
+    }
 }
 
-static BencodeItem *parse_dictionary(const char *data, size_t size, size_t *pos) {
-    if (*pos >= size || data[*pos] != 'd') return NULL;
-    (*pos)++; // Skip 'd'
+static bool scratch_push(BencodeParser *parser, CoreString *key, const BencodeItem *item) {
+    if (parser->scratch_count == parser->scratch_capacity) {
+        size_t new_capacity = parser->scratch_capacity * 2;
+        BencodeScratchEntry *new_scratch;
+        if (parser->scratch == parser->inline_scratch) {
+            new_scratch = (BencodeScratchEntry *)malloc(new_capacity * sizeof(BencodeScratchEntry));
+            if (new_scratch) {
+                memcpy(new_scratch, parser->inline_scratch, sizeof(parser->inline_scratch));
+            }
+        } else {
+            new_scratch = (BencodeScratchEntry *)realloc(parser->scratch, new_capacity * sizeof(BencodeScratchEntry));
+        }
+        if (!new_scratch) return false;
+        parser->scratch = new_scratch;
+        parser->scratch_capacity = new_capacity;
+    }
 
-    BencodeItem *dict_item = BencodeItem_create(BENCODE_TYPE_DICTIONARY);
-    if (!dict_item) return NULL;
+    parser->scratch[parser->scratch_count].key = key;
+    parser->scratch[parser->scratch_count].item = *item;
+    parser->scratch_count++;
+    return true;
+}
 
-    CoreList *keys = CoreList_create(10);
-    CoreList *values = CoreList_create(10);
-    if (!keys || !values) {
-        if (keys) CoreList_destroy(keys);
-        if (values) CoreList_destroy(values);
-        BencodeItem_destroy(dict_item);
-        return NULL;
+// Checks and converts eight ASCII digits at once (SWAR), data must have 8 readable bytes
+static inline bool parse_eight_digits(const char *data, uint64_t *out) {
+    uint64_t chunk;
+    memcpy(&chunk, data, sizeof(chunk));
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    chunk = __builtin_bswap64(chunk); // The math below wants the first digit in the lowest byte
+#endif
+
+    // A byte is a digit if its high nibble is 3 and adding 6 doesn't carry into the high nibble
+    uint64_t high = chunk & 0xF0F0F0F0F0F0F0F0ULL;
+    uint64_t carried = (chunk + 0x0606060606060606ULL) & 0xF0F0F0F0F0F0F0F0ULL;
+    if ((high | (carried >> 4)) != 0x3333333333333333ULL) return false;
+
+    // Combine neighbouring digits into 2, then 4, then 8 digit numbers
+    chunk -= 0x3030303030303030ULL;
+    chunk = (chunk * 10) + (chunk >> 8);
+    chunk = (((chunk & 0x000000FF000000FFULL) * (100 + (1000000ULL << 32))) +
+             (((chunk >> 16) & 0x000000FF000000FFULL) * (1 + (10000ULL << 32)))) >> 32;
+    *out = chunk;
+    return true;
+}
+
+#define BENCODE_MAX_DIGITS 19 // Always fits in a uint64_t, and nothing longer fits in an int64_t
+
+// Scans and accumulates the digits at parser->pos in a single pass.
+// Fails if there are no digits or too many of them, the caller checks the delimiter.
+static inline bool parse_digits(BencodeParser *parser, uint64_t *out, size_t *digits) {
+    const char *data = parser->data;
+    size_t size = parser->size;
+    size_t start = parser->pos;
+    size_t pos = start;
+    uint64_t value = 0;
+
+    // Long numbers (like the length of "pieces") go 8 digits at a time
+    uint64_t eight;
+    while (pos - start + 8 <= BENCODE_MAX_DIGITS && size - pos >= 8 && parse_eight_digits(data + pos, &eight)) {
+        value = value * 100000000ULL + eight;
+        pos += 8;
+    }
+    while (pos < size && data[pos] >= '0' && data[pos] <= '9') {
+        if (pos - start == BENCODE_MAX_DIGITS) return false;
+        value = value * 10 + (uint64_t)(data[pos] - '0');
+        pos++;
     }
 
-    while (*pos < size && data[*pos] != 'e') {
-        // Parse key (must be string)
-        BencodeItem *key_item = parse_next(data, size, pos);
-        if (!key_item || key_item->type != BENCODE_TYPE_STRING) {
-            BencodeItem_destroy(key_item);
-            goto dict_cleanup;
-        }
+    if (pos == start) return false;
+    parser->pos = pos;
+    *digits = pos - start;
+    *out = value;
+    return true;
+}
 
-        // Parse value
-        BencodeItem *value_item = parse_next(data, size, pos);
-        if (!value_item) {
-            BencodeItem_destroy(key_item);
-            goto dict_cleanup;
-        }
+// Parses "i<digits>e". BEP3 forbids leading zeros and "-0", and the value has to fit in an int64_t.
+static bool parse_integer(BencodeParser *parser, int64_t *out) {
+    const char *data = parser->data;
+    size_t size = parser->size;
+    if (parser->pos >= size || data[parser->pos] != 'i') return false;
+    parser->pos++; // Skip 'i'
+
+    bool negative = parser->pos < size && data[parser->pos] == '-';
+    if (negative) parser->pos++;
+
+    size_t start = parser->pos;
+    uint64_t magnitude;
+    size_t digits;
+    if (!parse_digits(parser, &magnitude, &digits)) return false;
+    if (digits > 1 && data[start] == '0') return false; // i03e
+    if (negative && magnitude == 0) return false; // i-0e
+
+    uint64_t limit = negative ? (uint64_t)INT64_MAX + 1 : (uint64_t)INT64_MAX;
+    if (magnitude > limit) return false;
+    if (parser->pos >= size || data[parser->pos] != 'e') return false;
+
+    *out = negative ? -(int64_t)(magnitude - 1) - 1 : (int64_t)magnitude; // Works for INT64_MIN too
+    parser->pos++; // Skip 'e'
+    return true;
+}
 
-        // Transfer ownership
-        CoreList_append(keys, key_item->value.string);
-        CoreList_append(values, value_item);
-        key_item->value.string = NULL; // Prevent double-free
-        BencodeItem_destroy(key_item);
+// Parses "<length>:" and checks the bytes are there, parser->pos is left at the first byte
+static inline bool parse_length_prefix(BencodeParser *parser, size_t *out) {
+    uint64_t length;
+    size_t digits;
+    if (!parse_digits(parser, &length, &digits)) return false;
+    if (parser->pos >= parser->size || parser->data[parser->pos] != ':') return false;
+    if (length > parser->size - parser->pos - 1) return false; // Longer than what is left of the input
+
+    parser->pos++; // Skip ':'
+    *out = (size_t)length;
+    return true;
+}
+
+// Parses "<length>:<bytes>". Copies the bytes, or points into the source buffer in zero-copy mode.
+static CoreString *parse_string(BencodeParser *parser) {
+    size_t str_len;
+    if (!parse_length_prefix(parser, &str_len)) return NULL;
+    const char *str_data = parser->data + parser->pos;
+    parser->pos += str_len;
+
+    if (!parser->options.arena) {
+        return parser->options.zero_copy
+            ? CoreString_create_view(str_data, str_len)
+            : CoreString_create_with_length(str_data, str_len);
     }
 
-    if (*pos >= size || data[*pos] != 'e') {
-        goto dict_cleanup;
+    CoreString *str = (CoreString *)CoreArena_alloc(parser->options.arena, sizeof(CoreString));
+    if (!str) return NULL;
+    str->length = str_len;
+    str->is_view = true; // Never freed on its own, the arena owns the bytes (or the caller does in zero-copy mode)
+    if (parser->options.zero_copy) {
+        str->str = (char *)str_data;
+    } else {
+        str->str = (char *)CoreArena_alloc(parser->options.arena, str_len + 1);
+        if (!str->str) return NULL;
+        memcpy(str->str, str_data, str_len);
+        str->str[str_len] = '\0';
     }
-    (*pos)++; // Skip 'e'
+    return str;
+}
 
-    // Create final dictionary
-    size_t count = CoreList_size(keys);
-    BencodeDictionary *bdict = (BencodeDictionary*)malloc(sizeof(BencodeDictionary));
-    if (!bdict) {
-        goto dict_cleanup;
+// Moves the children collected since base out of the scratch space into a list
+static bool finish_list(BencodeParser *parser, size_t base, BencodeItem *out) {
+    // Create final list structure, items are stored inline
+    size_t count = parser->scratch_count - base;
+    BencodeList *blist = (BencodeList*)parser_alloc(parser, sizeof(BencodeList));
+    BencodeItem *items = count > 0 ? (BencodeItem*)parser_alloc(parser, count * sizeof(BencodeItem)) : NULL;
+    if (!blist || (count > 0 && !items)) {
+        parser_free(parser, blist);
+        parser_free(parser, items);
+        return false;
     }
 
-    bdict->count = count;
-    bdict->keys = (CoreString**)malloc(count * sizeof(CoreString*));
-    bdict->values = (BencodeItem**)malloc(count * sizeof(BencodeItem*));
+    for (size_t i = 0; i < count; i++) {
+        items[i] = parser->scratch[base + i].item;
+    }
+    parser->scratch_count = base;
+
+    blist->count = count;
+    blist->items = items;
+    out->type = BENCODE_TYPE_LIST;
+    out->value.list = blist;
+    return true;
+}
+
+// Moves the key/value pairs collected since base out of the scratch space into a dictionary
+static bool finish_dictionary(BencodeParser *parser, size_t base, bool needs_sort, BencodeItem *out) {
+    // Create final dictionary
+    size_t count = parser->scratch_count - base;
+    BencodeDictionary *bdict = (BencodeDictionary*)parser_alloc(parser, sizeof(BencodeDictionary));
+    CoreString **keys = count > 0 ? (CoreString**)parser_alloc(parser, count * sizeof(CoreString*)) : NULL;
+    BencodeItem **values = count > 0 ? (BencodeItem**)parser_alloc(parser, count * sizeof(BencodeItem*)) : NULL;
+    if (!bdict || (count > 0 && (!keys || !values))) {
+        parser_free(parser, bdict);
+        parser_free(parser, keys);
+        parser_free(parser, values);
+        return false;
+    }
 
-    if (!bdict->keys || !bdict->values) {
-        free(bdict->keys);
-        free(bdict->values);
-        free(bdict);
-        goto dict_cleanup;
+    if (parser->options.arena) {
+        // One block for all values, there is nothing to free individually anyway
+        BencodeItem *value_block = count > 0 ? (BencodeItem*)CoreArena_alloc(parser->options.arena, count * sizeof(BencodeItem)) : NULL;
+        if (count > 0 && !value_block) return false;
+        for (size_t i = 0; i < count; i++) {
+            values[i] = &value_block[i];
+        }
+    } else {
+        // Values have to be freeable one by one (see free_dict)
+        for (size_t i = 0; i < count; i++) {
+            values[i] = (BencodeItem*)malloc(sizeof(BencodeItem));
+            if (!values[i]) {
+                for (size_t j = 0; j < i; j++) {
+                    free(values[j]);
+                }
+                free(bdict);
+                free(keys);
+                free(values);
+                return false;
+            }
+        }
     }
 
     for (size_t i = 0; i < count; i++) {
-        bdict->keys[i] = (CoreString*)CoreList_get(keys, i);
-        bdict->values[i] = (BencodeItem*)CoreList_get(values, i);
+        keys[i] = parser->scratch[base + i].key;
+        *values[i] = parser->scratch[base + i].item;
     }
+    parser->scratch_count = base;
 
-    dict_item->value.dictionary = bdict;
-    CoreList_destroy(keys);
-    CoreList_destroy(values);
-    return dict_item;
+    bdict->count = count;
+    bdict->keys = keys;
+    bdict->values = values;
+    out->type = BENCODE_TYPE_DICTIONARY;
+    out->value.dictionary = bdict;
 
-dict_cleanup:
-    // Cleanup on error
-    for (size_t i = 0; i < CoreList_size(keys); i++) {
-        CoreString_destroy((CoreString*)CoreList_get(keys, i));
+    if (needs_sort && !BencodeDictionary_sort(bdict)) {
+        parser_destroy_contents(parser, out);
+        return false;
     }
-    for (size_t i = 0; i < CoreList_size(values); i++) {
-        BencodeItem_destroy((BencodeItem*)CoreList_get(values, i));
+    return true;
+}
+
+static bool frame_push(BencodeParser *parser, BencodeType type) {
+    if (parser->frame_count == parser->max_depth) return false; // Nested too deep, most likely hostile input
+
+    if (parser->frame_count == parser->frame_capacity) {
+        size_t new_capacity = parser->frame_capacity * 2;
+        if (new_capacity > parser->max_depth) new_capacity = parser->max_depth;
+        BencodeParseFrame *new_frames;
+        if (parser->frames == parser->inline_frames) {
+            new_frames = (BencodeParseFrame *)malloc(new_capacity * sizeof(BencodeParseFrame));
+            if (new_frames) {
+                memcpy(new_frames, parser->inline_frames, sizeof(parser->inline_frames));
+            }
+        } else {
+            new_frames = (BencodeParseFrame *)realloc(parser->frames, new_capacity * sizeof(BencodeParseFrame));
+        }
+        if (!new_frames) return false;
+        parser->frames = new_frames;
+        parser->frame_capacity = new_capacity;
+    }
+
+    BencodeParseFrame *frame = &parser->frames[parser->frame_count++];
+    frame->type = type;
+    frame->base = parser->scratch_count;
+    frame->source_start = parser->pos;
+    frame->key = NULL;
+    frame->previous_key = NULL;
+    frame->needs_sort = false;
+    return true;
+}
+
+// Moves parser->pos past the list/dictionary at parser->pos without building anything (lazy mode).
+// Only the syntax and the depth are checked here, the rest (like keys being strings) when it is decoded.
+static bool skip_container(BencodeParser *parser) {
+    const char *data = parser->data;
+    size_t size = parser->size;
+    size_t depth = 0;
+    do {
+        if (parser->pos >= size) return false;
+        char c = data[parser->pos];
+        if (c == 'l' || c == 'd') {
+            if (parser->frame_count + depth == parser->max_depth) return false;
+            depth++;
+            parser->pos++;
+        } else if (c == 'e') {
+            depth--;
+            parser->pos++;
+        } else if (c == 'i') {
+            int64_t integer;
+            if (!parse_integer(parser, &integer)) return false;
+        } else if (c >= '0' && c <= '9') {
+            size_t length;
+            if (!parse_length_prefix(parser, &length)) return false;
+            parser->pos += length;
+        } else {
+            return false;
+        }
+    } while (depth > 0);
+    return true;
+}
+
+// Parses one complete value into out, without recursion: open containers live on the frame stack,
+// their children in the scratch space. On failure nothing is left allocated in out,
+// but entries may be left behind in the scratch space (the caller cleans those up).
+static bool parse_next(BencodeParser *parser, BencodeItem *out) {
+    const char *data = parser->data;
+    size_t size = parser->size;
+    BencodeItem value;
+
+    for (;;) {
+        if (parser->pos >= size) return false;
+        char c = data[parser->pos];
+        BencodeParseFrame *top = parser->frame_count > 0 ? &parser->frames[parser->frame_count - 1] : NULL;
+
+        if (top && top->type == BENCODE_TYPE_DICTIONARY && !top->key) {
+            if (c == 'e') {
+                parser->pos++; // Skip 'e'
+                if (!finish_dictionary(parser, top->base, top->needs_sort, &value)) return false;
+                goto close_container;
+            }
+
+            // Parse key (must be string), straight into a CoreString
+            CoreString *key = (c >= '0' && c <= '9') ? parse_string(parser) : NULL;
+            if (!key) return false;
+
+            // Keys must be sorted and unique, strict mode rejects anything else.
+            // Otherwise the dictionary is sorted afterwards, so lookups can rely on the order.
+            if (top->previous_key) {
+                int cmp = compare_keys(top->previous_key, key);
+                if (cmp >= 0 && parser->options.strict_key_order) {
+                    parser_destroy_string(parser, key);
+                    return false;
+                }
+                top->needs_sort |= cmp > 0;
+            }
+            top->previous_key = key;
+            top->key = key; // Owned by the frame until its value is complete
+            continue;
+        }
+
+        if (c == 'e' && top && top->type == BENCODE_TYPE_LIST) {
+            parser->pos++; // Skip 'e'
+            if (!finish_list(parser, top->base, &value)) return false;
+            goto close_container;
+        }
+
+        value.flags = parser->item_flags;
+        value.source_start = parser->pos;
+        if (c == 'i') {
+            value.type = BENCODE_TYPE_INTEGER;
+            if (!parse_integer(parser, &value.value.integer)) return false;
+        } else if (c >= '0' && c <= '9') {
+            value.type = BENCODE_TYPE_STRING;
+            value.value.string = parse_string(parser);
+            if (!value.value.string) return false;
+        } else if (c == 'l' || c == 'd') {
+            BencodeType type = c == 'l' ? BENCODE_TYPE_LIST : BENCODE_TYPE_DICTIONARY;
+            if (!parser->lazy || parser->frame_count == 0) {
+                if (!frame_push(parser, type)) return false;
+                parser->pos++; // Skip 'l' or 'd'
+                continue;
+            }
+
+            // Lazy mode only decodes the outermost container, the rest just remembers where it is
+            if (!skip_container(parser)) return false;
+            value.type = type;
+            value.flags |= BENCODE_ITEM_FLAG_LAZY;
+            value.value.lazy = parser->lazy;
+        } else {
+            return false; // Invalid type (or a dictionary value missing)
+        }
+        value.source_end = parser->pos;
+        goto value_complete;
+
+    close_container:
+        // The exact bytes this item was parsed from, e.g. for the info-hash
+        value.flags = parser->item_flags;
+        value.source_start = top->source_start;
+        value.source_end = parser->pos;
+        parser->frame_count--;
+
+    value_complete:
+        if (parser->frame_count == 0) {
+            *out = value;
+            return true;
+        }
+
+        top = &parser->frames[parser->frame_count - 1];
+        if (!scratch_push(parser, top->key, &value)) {
+            parser_destroy_contents(parser, &value);
+            return false;
+        }
+        top->key = NULL; // Now owned by the scratch entry
     }
-    CoreList_destroy(keys);
-    CoreList_destroy(values);
-    BencodeItem_destroy(dict_item);
-    return NULL;
 }
 
 void debug_print(BencodeItem* item, int tab) {
@@ -312,10 +658,14 @@ void debug_print(BencodeItem* item, int tab) {
         return; // Nothing to print
     }
 
-    if (item->type == BENCODE_TYPE_INTEGER) {
+    // Strings are printed with an explicit length, zero-copy strings are not null-terminated
+    if (item->flags & BENCODE_ITEM_FLAG_LAZY) {
+        printf("%*s%s: (not decoded, %zu bytes)\n", tab, "", item->type == BENCODE_TYPE_LIST ? "List" : "Dictionary",
+               item->source_end - item->source_start);
+    } else if (item->type == BENCODE_TYPE_INTEGER) {
         printf("%*sInteger: %lld\n", tab, "", (long long)item->value.integer);
     } else if (item->type == BENCODE_TYPE_STRING) {
-        printf("%*sString: '%s'\n", tab, "", item->value.string->str);
+        printf("%*sString: '%.*s'\n", tab, "", (int)item->value.string->length, item->value.string->str);
     } else if (item->type == BENCODE_TYPE_LIST) {
         printf("%*sList:\n", tab, "");
         for (size_t i = 0; i < item->value.list->count; i++) {
@@ -324,7 +674,8 @@ void debug_print(BencodeItem* item, int tab) {
     } else if (item->type == BENCODE_TYPE_DICTIONARY) {
         printf("%*sDictionary:\n", tab, "");
         for (size_t i = 0; i < item->value.dictionary->count; i++) {
-            printf("%*sKey: '%s'\n", tab + 2, "", item->value.dictionary->keys[i]->str);
+            CoreString *key = item->value.dictionary->keys[i];
+            printf("%*sKey: '%.*s'\n", tab + 2, "", (int)key->length, key->str);
             debug_print(item->value.dictionary->values[i], tab + 4);
         }
     } else {
@@ -334,209 +685,330 @@ void debug_print(BencodeItem* item, int tab) {
 
 /// Parse a BencodeItem from a data buffer.
 BencodeItem * BencodeItem_parse(const char *data, size_t size) {
-    if (data == NULL || size == 0) {
-        return NULL;
-    }
-
-    size_t pos = 0;
-    BencodeItem *item = parse_next(data, size, &pos);
-    if (item == NULL || pos != size) {
-        BencodeItem_destroy(item);
-        return NULL; // Parsing failed or not all data was consumed
-    }
+    BencodeItem *item = BencodeItem_parse_with_options(data, size, NULL);
 
     // Debug print
     debug_print(item, 0);
     return item;
 }
 
-
-// Helper function to compare two dictionary keys
-static int compare_keys(CoreString *key1, CoreString *key2) {
-    const char *s1 = key1->str;
-    size_t len1 = key1->length;
-    const char *s2 = key2->str;
-    size_t len2 = key2->length;
-
-    size_t min_len = len1 < len2 ? len1 : len2;
-    int cmp = memcmp(s1, s2, min_len);
-    if (cmp != 0) return cmp;
-    return (len1 > len2) - (len1 < len2);  // Compare lengths if prefixes match
+static void parser_init(BencodeParser *parser, const char *data, size_t size, const BencodeParseOptions *options) {
+    *parser = (BencodeParser){ .data = data, .size = size };
+    if (options) {
+        parser->options = *options;
+    }
+    parser->item_flags = parser->options.arena ? BENCODE_ITEM_FLAG_ARENA : 0;
+    parser->scratch = parser->inline_scratch;
+    parser->scratch_capacity = BENCODE_INLINE_SCRATCH;
+    parser->frames = parser->inline_frames;
+    parser->frame_capacity = BENCODE_INLINE_FRAMES;
+    parser->max_depth = parser->options.max_depth > 0 ? parser->options.max_depth : BENCODE_MAX_STACK_SIZE;
 }
 
-// Serialization buffer structure
-typedef struct {
-    uint8_t* data;
-    size_t size;
-    size_t capacity;
-} BencodeBuffer;
+// Parses one value that has to end exactly at the end of the input, and releases the parser.
+// On failure everything that was parsed so far is freed again.
+static bool parser_run(BencodeParser *parser, BencodeItem *out) {
+    bool parsed = parse_next(parser, out);
+    bool success = parsed && parser->pos == parser->size; // Not all data consumed is an error too
+
+    if (!success) {
+        // Whatever was parsed before the error is still sitting in the scratch space
+        for (size_t i = 0; i < parser->scratch_count; i++) {
+            parser_destroy_string(parser, parser->scratch[i].key);
+            parser_destroy_contents(parser, &parser->scratch[i].item);
+        }
+        // And so are the keys of open dictionaries that were still waiting for a value
+        for (size_t i = 0; i < parser->frame_count; i++) {
+            parser_destroy_string(parser, parser->frames[i].key);
+        }
+        if (parsed) {
+            parser_destroy_contents(parser, out);
+        }
+    }
 
-// Create a new buffer
-static BencodeBuffer* bencode_buffer_create(void) {
-    BencodeBuffer* buf = malloc(sizeof(BencodeBuffer));
-    if (buf) {
-        buf->data = NULL;
-        buf->size = 0;
-        buf->capacity = 0;
+    if (parser->scratch != parser->inline_scratch) {
+        free(parser->scratch);
     }
-    return buf;
+    if (parser->frames != parser->inline_frames) {
+        free(parser->frames);
+    }
+    return success;
 }
 
-// Append data to buffer
-static bool bencode_buffer_append(BencodeBuffer* buf, const void* data, size_t len) {
-    if (buf->size + len > buf->capacity) {
-        size_t new_capacity = buf->capacity ? buf->capacity * 2 : 256;
-        if (new_capacity < buf->size + len)
-            new_capacity = buf->size + len;
+/// Parse a BencodeItem from a data buffer, see BencodeParseOptions for the available modes.
+/// Passing NULL options behaves like BencodeItem_parse (minus the debug print).
+/// Arena-backed trees are released with the arena (CoreArena_reset/CoreArena_destroy), not with BencodeItem_destroy.
+/// Lazy mode requires an arena, and the buffer has to outlive the tree since nested containers are decoded from it later.
+BencodeItem * BencodeItem_parse_with_options(const char *data, size_t size, const BencodeParseOptions *options) {
+    if (data == NULL || size == 0) {
+        return NULL;
+    }
+    if (options && options->lazy && !options->arena) {
+        return NULL; // Decoded subtrees need somewhere to live that doesn't have to be freed by hand
+    }
 
-        uint8_t* new_data = realloc(buf->data, new_capacity);
-        if (!new_data) return false;
+    BencodeParser parser;
+    parser_init(&parser, data, size, options);
+    if (parser.options.lazy) {
+        parser.lazy = (BencodeLazySource *)CoreArena_alloc(parser.options.arena, sizeof(BencodeLazySource));
+        if (!parser.lazy) return NULL;
+        parser.lazy->data = data;
+        parser.lazy->options = parser.options;
+    }
 
-        buf->data = new_data;
-        buf->capacity = new_capacity;
+    BencodeItem value;
+    if (!parser_run(&parser, &value)) {
+        return NULL;
     }
 
-    memcpy(buf->data + buf->size, data, len);
-    buf->size += len;
-    return true;
+    BencodeItem *item = (BencodeItem *)parser_alloc(&parser, sizeof(BencodeItem));
+    if (item) {
+        *item = value;
+    } else {
+        parser_destroy_contents(&parser, &value);
+    }
+    return item;
 }
 
-// Append a single character to buffer
-static bool bencode_buffer_append_char(BencodeBuffer* buf, char c) {
-    return bencode_buffer_append(buf, &c, 1);
+// Decodes one level of a lazy item in place, the containers inside it stay lazy.
+// Spans keep referring to the original buffer, so the info-hash still works on lazily decoded items.
+static bool materialize(BencodeItem *item) {
+    BencodeLazySource *lazy = item->value.lazy;
+    BencodeParser parser;
+    parser_init(&parser, lazy->data, item->source_end, &lazy->options);
+    parser.pos = item->source_start;
+    parser.lazy = lazy;
+
+    BencodeItem value;
+    if (!parser_run(&parser, &value)) {
+        return false; // Stays lazy, the error is reported again on the next access
+    }
+    *item = value;
+    return true;
 }
 
-// Serialization functions for different Bencode types
-static bool save_integer_to_buffer(BencodeItem *item, BencodeBuffer *buf);
-static bool save_string_to_buffer(BencodeItem *item, BencodeBuffer *buf);
-static bool save_list_to_buffer(BencodeItem *item, BencodeBuffer *buf);
-static bool save_dictionary_to_buffer(BencodeItem *item, BencodeBuffer *buf);
-
-// Main serialization function
-static bool save_item_to_buffer(BencodeItem *item, BencodeBuffer *buf) {
-    switch (item->type) {
-        case BENCODE_TYPE_INTEGER:
-            return save_integer_to_buffer(item, buf);
-        case BENCODE_TYPE_STRING:
-            return save_string_to_buffer(item, buf);
-        case BENCODE_TYPE_LIST:
-            return save_list_to_buffer(item, buf);
-        case BENCODE_TYPE_DICTIONARY:
-            return save_dictionary_to_buffer(item, buf);
-        default:
-            return false;
+/// Get the list of a list item, decoding it first if it was parsed lazily.
+/// Returns NULL if the item is not a list, or if its lazily parsed data turns out to be invalid.
+/// Decoding modifies the item, so lazy trees must not be accessed from several threads at once.
+BencodeList * BencodeItem_get_list(BencodeItem *item) {
+    if (item == NULL || item->type != BENCODE_TYPE_LIST) {
+        return NULL;
     }
+    if ((item->flags & BENCODE_ITEM_FLAG_LAZY) && !materialize(item)) {
+        return NULL;
+    }
+    return item->value.list;
 }
 
-// Integer serialization
-static bool save_integer_to_buffer(BencodeItem *item, BencodeBuffer *buf) {
-    char temp[64];
-    int n = snprintf(temp, sizeof(temp), "i%llde", (long long)item->value.integer);
-    if (n < 0 || (size_t)n >= sizeof(temp)) return false;
-    return bencode_buffer_append(buf, temp, (size_t)n);
+/// Get the dictionary of a dictionary item, decoding it first if it was parsed lazily. See BencodeItem_get_list.
+BencodeDictionary * BencodeItem_get_dictionary(BencodeItem *item) {
+    if (item == NULL || item->type != BENCODE_TYPE_DICTIONARY) {
+        return NULL;
+    }
+    if ((item->flags & BENCODE_ITEM_FLAG_LAZY) && !materialize(item)) {
+        return NULL;
+    }
+    return item->value.dictionary;
 }
 
-// String serialization
-static bool save_string_to_buffer(BencodeItem *item, BencodeBuffer *buf) {
-    if (!item->value.string) return false;
-
-    const char *str = item->value.string->str;
-    size_t len = item->value.string->length;
-
-    char prefix[32];
-    int prefix_len = snprintf(prefix, sizeof(prefix), "%zu:", len);
-    if (prefix_len < 0 || (size_t)prefix_len >= sizeof(prefix)) return false;
-
-    return bencode_buffer_append(buf, prefix, (size_t)prefix_len) &&
-           (len == 0 || bencode_buffer_append(buf, str, len));
+// Serialization is done in two passes: measure the exact encoded size, then write into one allocation
+
+static const char decimal_pairs[] =
+    "00010203040506070809"
+    "10111213141516171819"
+    "20212223242526272829"
+    "30313233343536373839"
+    "40414243444546474849"
+    "50515253545556575859"
+    "60616263646566676869"
+    "70717273747576777879"
+    "80818283848586878889"
+    "90919293949596979899";
+
+static size_t decimal_length(uint64_t value) {
+    size_t length = 1;
+    while (value >= 10) {
+        value /= 10;
+        length++;
+    }
+    return length;
 }
 
-// List serialization
-static bool save_list_to_buffer(BencodeItem *item, BencodeBuffer *buf) {
-    if (!item->value.list) return false;
-    if (!bencode_buffer_append_char(buf, 'l')) return false;
-
-    BencodeList *list = item->value.list;
-    for (size_t i = 0; i < list->count; i++) {
-        if (!save_item_to_buffer(&list->items[i], buf)) return false;
+// Writes value in decimal, two digits at a time from the back. Returns the end of what was written.
+static uint8_t *write_decimal(uint8_t *out, uint64_t value) {
+    uint8_t *end = out + decimal_length(value);
+    uint8_t *p = end;
+    while (value >= 100) {
+        size_t pair = (size_t)(value % 100) * 2;
+        value /= 100;
+        *--p = (uint8_t)decimal_pairs[pair + 1];
+        *--p = (uint8_t)decimal_pairs[pair];
     }
+    if (value >= 10) {
+        *--p = (uint8_t)decimal_pairs[value * 2 + 1];
+        *--p = (uint8_t)decimal_pairs[value * 2];
+    } else {
+        *--p = (uint8_t)('0' + value);
+    }
+    return end;
+}
 
-    return bencode_buffer_append_char(buf, 'e');
+static uint64_t integer_magnitude(int64_t value) {
+    return value < 0 ? 0 - (uint64_t)value : (uint64_t)value; // Works for INT64_MIN too
 }
 
-// Dictionary serialization with insertion sort
-static bool save_dictionary_to_buffer(BencodeItem *item, BencodeBuffer *buf) {
-    if (!item->value.dictionary) return false;
-    BencodeDictionary *dict = item->value.dictionary;
-    size_t count = dict->count;
+// Gets the order in which the keys have to be written. Sets *out_indices to NULL if they are
+// already sorted (always true for parsed dictionaries), otherwise the caller frees it.
+static bool dictionary_key_order(const BencodeDictionary *dict, size_t **out_indices) {
+    *out_indices = NULL;
 
-    if (!bencode_buffer_append_char(buf, 'd')) return false;
-    if (count == 0) return bencode_buffer_append_char(buf, 'e');
+    bool sorted = true;
+    for (size_t i = 1; i < dict->count && sorted; i++) {
+        sorted = compare_keys(dict->keys[i - 1], dict->keys[i]) <= 0;
+    }
+    if (sorted) return true;
 
-    // Create and sort index array using insertion sort
-    size_t *indices = malloc(count * sizeof(size_t));
+    size_t *indices = (size_t *)malloc(dict->count * sizeof(size_t));
     if (!indices) return false;
+    for (size_t i = 0; i < dict->count; i++) {
+        indices[i] = i;
+    }
+    if (!sort_key_indices(dict->keys, indices, dict->count)) {
+        free(indices);
+        return false;
+    }
+    *out_indices = indices;
+    return true;
+}
 
-    // Initialize indices
-    for (size_t i = 0; i < count; i++) indices[i] = i;
-
-    // Insertion sort for lexicographical order
-    for (size_t i = 1; i < count; i++) {
-        size_t j = i;
-        while (j > 0) {
-            size_t prev_idx = indices[j-1];
-            size_t curr_idx = indices[j];
+// Exact number of bytes the item encodes to, 0 if the item is malformed
+static size_t encoded_size(const BencodeItem *item) {
+    if (item->flags & BENCODE_ITEM_FLAG_LAZY) {
+        return item->source_end - item->source_start; // Written as it was parsed
+    }
 
-            CoreString *prev_key = dict->keys[prev_idx];
-            CoreString *curr_key = dict->keys[curr_idx];
+    switch (item->type) {
+        case BENCODE_TYPE_INTEGER:
+            return 2 + (item->value.integer < 0) + decimal_length(integer_magnitude(item->value.integer));
+        case BENCODE_TYPE_STRING: {
+            const CoreString *str = item->value.string;
+            if (!str) return 0;
+            return decimal_length(str->length) + 1 + str->length;
+        }
+        case BENCODE_TYPE_LIST: {
+            const BencodeList *list = item->value.list;
+            if (!list) return 0;
+            size_t size = 2;
+            for (size_t i = 0; i < list->count; i++) {
+                size_t child = encoded_size(&list->items[i]);
+                if (child == 0) return 0;
+                size += child;
+            }
+            return size;
+        }
+        case BENCODE_TYPE_DICTIONARY: {
+            const BencodeDictionary *dict = item->value.dictionary;
+            if (!dict) return 0;
+            size_t size = 2;
+            for (size_t i = 0; i < dict->count; i++) {
+                const CoreString *key = dict->keys[i];
+                size_t child = dict->values[i] ? encoded_size(dict->values[i]) : 0;
+                if (!key || child == 0) return 0;
+                size += decimal_length(key->length) + 1 + key->length + child;
+            }
+            return size;
+        }
+        default:
+            return 0;
+    }
+}
 
-            if (compare_keys(prev_key, curr_key) <= 0) break;
+static uint8_t *write_string(uint8_t *out, const char *str, size_t length) {
+    out = write_decimal(out, length);
+    *out++ = ':';
+    if (length > 0) {
+        memcpy(out, str, length);
+    }
+    return out + length;
+}
 
-            // Swap indices
-            indices[j] = prev_idx;
-            indices[j-1] = curr_idx;
-            j--;
-        }
+// Writes the item, out must have room for encoded_size(item) bytes. Returns the end, or NULL on failure.
+static uint8_t *write_item(const BencodeItem *item, uint8_t *out) {
+    if (item->flags & BENCODE_ITEM_FLAG_LAZY) {
+        size_t length = item->source_end - item->source_start;
+        memcpy(out, item->value.lazy->data + item->source_start, length);
+        return out + length;
     }
 
-    // Serialize in sorted order
-    for (size_t i = 0; i < count; i++) {
-        size_t idx = indices[i];
-        CoreString *key = dict->keys[idx];
-        BencodeItem *value = dict->values[idx];
-
-        // Save key
-        char prefix[32];
-        int prefix_len = snprintf(prefix, sizeof(prefix), "%zu:", key->length);
-        if (prefix_len < 0 || (size_t)prefix_len >= sizeof(prefix)) {
-            free(indices);
-            return false;
+    switch (item->type) {
+        case BENCODE_TYPE_INTEGER:
+            *out++ = 'i';
+            if (item->value.integer < 0) {
+                *out++ = '-';
+            }
+            out = write_decimal(out, integer_magnitude(item->value.integer));
+            *out++ = 'e';
+            return out;
+        case BENCODE_TYPE_STRING:
+            return write_string(out, item->value.string->str, item->value.string->length);
+        case BENCODE_TYPE_LIST: {
+            const BencodeList *list = item->value.list;
+            *out++ = 'l';
+            for (size_t i = 0; i < list->count && out; i++) {
+                out = write_item(&list->items[i], out);
+            }
+            if (out) {
+                *out++ = 'e';
+            }
+            return out;
         }
-
-        if (!bencode_buffer_append(buf, prefix, (size_t)prefix_len) ||
-            !bencode_buffer_append(buf, key->str, key->length) ||
-            !save_item_to_buffer(value, buf)) {
+        case BENCODE_TYPE_DICTIONARY: {
+            // Keys must be written in sorted order, as bencode requires
+            const BencodeDictionary *dict = item->value.dictionary;
+            size_t *indices;
+            if (!dictionary_key_order(dict, &indices)) return NULL;
+
+            *out++ = 'd';
+            for (size_t i = 0; i < dict->count && out; i++) {
+                size_t idx = indices ? indices[i] : i;
+                out = write_string(out, dict->keys[idx]->str, dict->keys[idx]->length);
+                out = write_item(dict->values[idx], out);
+            }
+            if (out) {
+                *out++ = 'e';
+            }
             free(indices);
-            return false;
+            return out;
         }
+        default:
+            return NULL;
     }
+}
 
-    free(indices);
-    return bencode_buffer_append_char(buf, 'e');
+/// Get the exact number of bytes BencodeItem_to_bytes will produce for this item. Returns 0 if the item is malformed.
+size_t BencodeItem_encoded_size(const BencodeItem *item) {
+    if (!item) return 0;
+    return encoded_size(item);
 }
 
-// Convert BencodeItem to byte array
-uint8_t* BencodeItem_to_bytes(const BencodeItem* item, size_t* out_size) {
+/// Serialize a BencodeItem into a newly allocated buffer, the caller frees it. Dictionary keys are written in sorted order.
+uint8_t * BencodeItem_to_bytes(const BencodeItem *item, size_t *out_size) {
     if (!item || !out_size) return NULL;
 
-    BencodeBuffer buf = {0};
-    if (!save_item_to_buffer((BencodeItem*)item, &buf)) {
-        free(buf.data);
+    size_t size = encoded_size(item);
+    if (size == 0) return NULL;
+
+    uint8_t *data = (uint8_t *)malloc(size);
+    if (!data) return NULL;
+
+    uint8_t *end = write_item(item, data);
+    if (end != data + size) {
+        free(data);
         return NULL;
     }
 
-    *out_size = buf.size;
-    return buf.data;
+    *out_size = size;
+    return data;
 }
 
 // Compute SHA1 hash of BencodeItem
@@ -547,178 +1019,196 @@ uint8_t* BencodeItem_compute_sha1(const BencodeItem* item) {
     uint8_t* buffer = BencodeItem_to_bytes(item, &buf_size);
     if (!buffer || !buf_size) return NULL;
 
-    uint8_t hash[CC_SHA1_DIGEST_LENGTH];
-    CC_SHA1_CTX ctx;
-    CC_SHA1_Init(&ctx);
-    CC_SHA1_Update(&ctx, buffer, (CC_LONG)buf_size);
-    CC_SHA1_Final(hash, &ctx);
-
+    uint8_t hash[CORE_SHA1_DIGEST_LENGTH];
+    CoreSha1_hash(buffer, buf_size, hash);
     free(buffer);
 
-    uint8_t* hash_copy = malloc(CC_SHA1_DIGEST_LENGTH);
-    if (hash_copy) memcpy(hash_copy, hash, CC_SHA1_DIGEST_LENGTH);
+    uint8_t* hash_copy = malloc(CORE_SHA1_DIGEST_LENGTH);
+    if (hash_copy) memcpy(hash_copy, hash, CORE_SHA1_DIGEST_LENGTH);
     return hash_copy;
 }
 
-static bool write_char(CoreFile *file, char c) {
-    return CoreFile_write(file, &c, 1) == 1;
-}
+/// Get the exact bytes an item was parsed from. source must be the buffer that was passed to the parser.
+/// Returns NULL for items that weren't parsed (or don't fit in source).
+const char * BencodeItem_source_span(const BencodeItem *item, const char *source, size_t source_size, size_t *out_length) {
+    if (!item || !source || !out_length) return NULL;
+    if (item->source_end <= item->source_start || item->source_end > source_size) return NULL;
 
-static bool write_buffer(CoreFile *file, const void *buf, size_t len) {
-    return CoreFile_write(file, buf, len) == (uint64_t)len;
+    *out_length = item->source_end - item->source_start;
+    return source + item->source_start;
 }
 
-static bool save_integer(BencodeItem *item, CoreFile *file) {
-    char temp[64];
-    int n = snprintf(temp, sizeof(temp), "i%llde", (long long)item->value.integer);
-    if (n < 0 || (size_t)n >= sizeof(temp)) {
-        return false;
-    }
-    return write_buffer(file, temp, (size_t)n);
-}
+/// Compute the SHA1 hash of the bytes the item was parsed from, without re-encoding it.
+/// This is what the info-hash is defined over, so it is also correct for non-canonical torrents.
+bool BencodeItem_compute_sha1_from_source(const BencodeItem *item, const char *source, size_t source_size,
+                                          uint8_t out_hash[BENCODE_SHA1_LENGTH]) {
+    size_t length = 0;
+    const char *span = BencodeItem_source_span(item, source, source_size, &length);
+    if (!span || !out_hash) return false;
 
-static bool save_string(BencodeItem *item, CoreFile *file) {
-    if (item->value.string == NULL) {
-        return false;
-    }
+    CoreSha1_hash(span, length, out_hash);
+    return true;
+}
 
-    const char *data = item->value.string->str;
-    size_t len = item->value.string->length;
+// Saving gathers the encoding as iovecs: delimiters, prefixes and short strings are packed into one staging
+// buffer, long strings (like "pieces") are written straight from the item without being copied.
+#define BENCODE_SAVE_COPY_LIMIT 512
 
-    char prefix[32];
-    int prefix_len = snprintf(prefix, sizeof(prefix), "%zu:", len);
-    if (prefix_len < 0 || (size_t)prefix_len >= sizeof(prefix)) {
-        return false;
+typedef struct {
+    struct iovec *segments;
+    size_t count;
+    uint8_t *run_start; // Start of the staging bytes not covered by a segment yet
+    uint8_t *out; // Next free byte in the staging buffer
+} BencodeSaveWriter;
+
+// Bytes of the encoding that are not copied into the staging buffer, and how many strings that is
+static void count_direct_strings(const BencodeItem *item, size_t *direct_bytes, size_t *direct_count) {
+    if (item->flags & BENCODE_ITEM_FLAG_LAZY) {
+        return; // Copied into the staging buffer as a whole
     }
 
-    if (!write_buffer(file, prefix, (size_t)prefix_len)) {
-        return false;
-    }
-    if (len > 0) {
-        return write_buffer(file, data, len);
+    if (item->type == BENCODE_TYPE_STRING) {
+        if (item->value.string->length >= BENCODE_SAVE_COPY_LIMIT) {
+            *direct_bytes += item->value.string->length;
+            (*direct_count)++;
+        }
+    } else if (item->type == BENCODE_TYPE_LIST) {
+        for (size_t i = 0; i < item->value.list->count; i++) {
+            count_direct_strings(&item->value.list->items[i], direct_bytes, direct_count);
+        }
+    } else if (item->type == BENCODE_TYPE_DICTIONARY) {
+        for (size_t i = 0; i < item->value.dictionary->count; i++) {
+            count_direct_strings(item->value.dictionary->values[i], direct_bytes, direct_count);
+        }
     }
-    return true;
 }
 
-static bool save_list(BencodeItem *item, CoreFile *file) {
-    if (item->value.list == NULL) {
-        return false;
+static void writer_end_run(BencodeSaveWriter *writer) {
+    if (writer->out > writer->run_start) {
+        writer->segments[writer->count].iov_base = writer->run_start;
+        writer->segments[writer->count].iov_len = (size_t)(writer->out - writer->run_start);
+        writer->count++;
     }
+    writer->run_start = writer->out;
+}
 
-    if (!write_char(file, 'l')) {
-        return false;
+static bool gather_item(const BencodeItem *item, BencodeSaveWriter *writer) {
+    if (item->flags & BENCODE_ITEM_FLAG_LAZY) {
+        writer->out = write_item(item, writer->out);
+        return true;
     }
 
-    BencodeList *lst = item->value.list;
-    for (size_t i = 0; i < lst->count; i++) {
-        BencodeItem *child = &(lst->items[i]);
-        if (!BencodeItem_save(child, file)) {
-            return false;
+    switch (item->type) {
+        case BENCODE_TYPE_INTEGER:
+            writer->out = write_item(item, writer->out);
+            return true;
+        case BENCODE_TYPE_STRING: {
+            const CoreString *str = item->value.string;
+            if (str->length < BENCODE_SAVE_COPY_LIMIT) {
+                writer->out = write_string(writer->out, str->str, str->length);
+                return true;
+            }
+            writer->out = write_decimal(writer->out, str->length);
+            *writer->out++ = ':';
+            writer_end_run(writer);
+            writer->segments[writer->count].iov_base = str->str;
+            writer->segments[writer->count].iov_len = str->length;
+            writer->count++;
+            return true;
+        }
+        case BENCODE_TYPE_LIST:
+            *writer->out++ = 'l';
+            for (size_t i = 0; i < item->value.list->count; i++) {
+                if (!gather_item(&item->value.list->items[i], writer)) return false;
+            }
+            *writer->out++ = 'e';
+            return true;
+        case BENCODE_TYPE_DICTIONARY: {
+            const BencodeDictionary *dict = item->value.dictionary;
+            size_t *indices;
+            if (!dictionary_key_order(dict, &indices)) return false;
+
+            bool ok = true;
+            *writer->out++ = 'd';
+            for (size_t i = 0; i < dict->count && ok; i++) {
+                size_t idx = indices ? indices[i] : i;
+                writer->out = write_string(writer->out, dict->keys[idx]->str, dict->keys[idx]->length);
+                ok = gather_item(dict->values[idx], writer);
+            }
+            if (ok) {
+                *writer->out++ = 'e';
+            }
+            free(indices);
+            return ok;
         }
+        default:
+            return false;
     }
-
-    return write_char(file, 'e');
 }
 
-typedef struct {
-    BencodeDictionary *dict;
-    size_t *indices;
-} DictSortCtx;
-
-static DictSortCtx *g_sort_ctx = NULL;
-static int dict_cmp_with_ctx(const void *a, const void *b) {
-    size_t i1 = *(const size_t *)a;
-    size_t i2 = *(const size_t *)b;
-    CoreString *key1 = g_sort_ctx->dict->keys[i1];
-    CoreString *key2 = g_sort_ctx->dict->keys[i2];
-
-    const char *s1 = key1->str;
-    size_t len1 = key1->length;
-    const char *s2 = key2->str;
-    size_t len2 = key2->length;
-
-    /* Perform lexicographical comparison over raw bytes */
-    size_t minlen = (len1 < len2) ? len1 : len2;
-    int cmp = memcmp(s1, s2, minlen);
-    if (cmp != 0) {
-        return cmp;
-    }
-    if (len1 < len2) {
-        return -1;
-    } else if (len1 > len2) {
-        return 1;
-    }
-    return 0;
-}
-
-static bool save_dictionary(BencodeItem *item, CoreFile *file) {
-    if (item->value.dictionary == NULL) {
-        return false;
-    }
+// Builds the segments for item, the caller frees *out_segments and *out_staging (also on failure)
+static bool gather_segments(const BencodeItem *item, struct iovec **out_segments, size_t *out_count, uint8_t **out_staging) {
+    *out_segments = NULL;
+    *out_staging = NULL;
 
-    BencodeDictionary *dict = item->value.dictionary;
-    size_t count = dict->count;
-    if (count == 0) {
-        /* Even an empty dictionary is "de" */
-        if (!write_char(file, 'd')) {
-            return false;
-        }
-        return write_char(file, 'e');
-    }
+    size_t size = encoded_size(item); // Also checks the whole tree is well-formed
+    if (size == 0) return false;
 
-    size_t *indices = malloc(sizeof(size_t) * count);
-    if (!indices) {
-        return false;
-    }
-    for (size_t i = 0; i < count; i++) {
-        indices[i] = i;
-    }
+    size_t direct_bytes = 0;
+    size_t direct_count = 0;
+    count_direct_strings(item, &direct_bytes, &direct_count);
 
-    DictSortCtx sort_ctx = { .dict = dict, .indices = indices };
-    g_sort_ctx = &sort_ctx;
-    qsort(indices, count, sizeof(size_t), dict_cmp_with_ctx);
-    g_sort_ctx = NULL;
+    // Every direct string ends a staging run, plus the run after the last one
+    BencodeSaveWriter writer = {0};
+    writer.segments = (struct iovec *)malloc((direct_count * 2 + 1) * sizeof(struct iovec));
+    uint8_t *staging = (uint8_t *)malloc(size - direct_bytes);
+    *out_segments = writer.segments;
+    *out_staging = staging;
+    if (!writer.segments || !staging) return false;
 
-    if (!write_char(file, 'd')) {
-        free(indices);
-        return false;
-    }
+    writer.run_start = staging;
+    writer.out = staging;
+    if (!gather_item(item, &writer)) return false;
+    writer_end_run(&writer);
 
-    for (size_t ix = 0; ix < count; ix++) {
-        size_t idx = indices[ix];
-        CoreString *key = dict->keys[idx];
-        BencodeItem *val = dict->values[idx];
+    *out_count = writer.count;
+    return true;
+}
 
-        {
-            const char *kdata = key->str;
-            size_t klen = key->length;
-            char prefix[32];
-            int plen = snprintf(prefix, sizeof(prefix), "%zu:", klen);
-            if (plen < 0 || (size_t)plen >= sizeof(prefix)) {
-                free(indices);
-                return false;
-            }
-            if (!write_buffer(file, prefix, (size_t)plen)) {
-                free(indices);
-                return false;
-            }
-            if (klen > 0 && !write_buffer(file, kdata, klen)) {
-                free(indices);
-                return false;
-            }
-        }
+/// Save a BencodeItem to a file. Dictionary keys are written in sorted order, as bencode requires.
+/// The encoding is written in a few large chunks, long strings straight from the item.
+bool BencodeItem_save(BencodeItem *item, CoreFile *file) {
+    if (item == NULL || file == NULL) {
+        return false;
+    }
 
-        if (!BencodeItem_save(val, file)) {
-            free(indices);
-            return false;
-        }
+    struct iovec *segments;
+    size_t count = 0;
+    uint8_t *staging;
+    bool ok = gather_segments(item, &segments, &count, &staging);
+    for (size_t i = 0; i < count && ok; i++) {
+        ok = CoreFile_write(file, segments[i].iov_base, segments[i].iov_len) == segments[i].iov_len;
     }
 
-    if (!write_char(file, 'e')) {
-        free(indices);
+    free(segments);
+    free(staging);
+    return ok;
+}
+
+/// Save a BencodeItem to path with a single vectored write, then atomically replace the old file.
+/// Either the old or the new file is left behind, never a partial one (e.g. for fast-resume data).
+bool BencodeItem_save_to_path(const BencodeItem *item, const char *path) {
+    if (item == NULL || path == NULL) {
         return false;
     }
 
-    free(indices);
-    return true;
+    struct iovec *segments;
+    size_t count = 0;
+    uint8_t *staging;
+    bool ok = gather_segments(item, &segments, &count, &staging) &&
+              CoreFile_write_atomic(path, segments, count);
+
+    free(segments);
+    free(staging);
+    return ok;
 }
@@ -6,10 +6,12 @@
 #include <CoreStack.h>
 #include <CoreList.h>
 #include <CoreDictionary.h>
+#include <CoreArena.h>
 
 // Bencode ends properties with 'e', so an int property would look like i42e, where i is the int type, and e the end with 42 the value.
 #define BENCODE_END_PROPERTY 'e'
 #define BENCODE_MAX_STACK_SIZE 1024 // If we have more than 1024 nested items, what?
+#define BENCODE_SHA1_LENGTH 20
 
 typedef enum {
     BENCODE_TYPE_INTEGER,
@@ -18,8 +20,12 @@ typedef enum {
     BENCODE_TYPE_DICTIONARY
 } BencodeType;
 
+#define BENCODE_ITEM_FLAG_ARENA 0x1 // Lives in a CoreArena, BencodeItem_destroy leaves it alone
+#define BENCODE_ITEM_FLAG_LAZY 0x2 // List/dictionary that is not decoded yet, use BencodeItem_get_list/BencodeItem_get_dictionary
+
 // Predefine BencodeItem so we can use it in BencodeList and BencodeDictionary
 typedef struct BencodeItem BencodeItem;
+typedef struct BencodeLazySource BencodeLazySource; // Where lazy items decode themselves from
 
 typedef struct {
     BencodeItem *items;
@@ -34,19 +40,49 @@ typedef struct {
 
 struct BencodeItem {
     BencodeType type;
+    uint32_t flags; // BENCODE_ITEM_FLAG_*
+    size_t source_start; // Byte range [start, end) this item was parsed from, 0-0 for items built by hand
+    size_t source_end;
     union {
         int64_t integer;
         CoreString *string;
         BencodeList *list;
         BencodeDictionary *dictionary;
+        BencodeLazySource *lazy; // Only with BENCODE_ITEM_FLAG_LAZY
     } value;
 };
 
+typedef struct {
+    bool zero_copy; // Strings and keys point into the parsed buffer instead of being copied, keep the buffer alive!
+    CoreArena *arena; // Allocate the whole tree from this arena, it is freed by resetting/destroying the arena
+    bool strict_key_order; // Reject dictionaries with unsorted or duplicate keys (they get sorted otherwise)
+    size_t max_depth; // Maximum nesting of lists/dictionaries, 0 means BENCODE_MAX_STACK_SIZE
+    bool lazy; // Nested lists/dictionaries are only decoded when first accessed, needs an arena and keeps pointing into the buffer
+} BencodeParseOptions;
+
 BencodeItem *BencodeItem_create(BencodeType type); // After creating, you can make it whatever you want.
 void BencodeItem_destroy(BencodeItem *item);
 
 BencodeItem *BencodeItem_parse(const char* data, size_t size);
+BencodeItem *BencodeItem_parse_with_options(const char* data, size_t size, const BencodeParseOptions *options);
 bool BencodeItem_save(BencodeItem *item, CoreFile *file); // First you have to create a file (CoreFile_create) and then you can save it to the file.
+bool BencodeItem_save_to_path(const BencodeItem *item, const char *path); // Atomically replaces the file at path
 
+// Dictionary lookups are a binary search, keys have to be sorted (parsed dictionaries always are)
+BencodeItem *BencodeDictionary_get(const BencodeDictionary *dict, const char *key);
+BencodeItem *BencodeDictionary_get_with_length(const BencodeDictionary *dict, const char *key, size_t key_length);
+bool BencodeDictionary_sort(BencodeDictionary *dict); // Only needed for dictionaries built by hand
+
+// The contents of a list/dictionary item, decoding it first if it was parsed lazily. NULL on a type mismatch or invalid data.
+BencodeList *BencodeItem_get_list(BencodeItem *item);
+BencodeDictionary *BencodeItem_get_dictionary(BencodeItem *item);
+
+size_t BencodeItem_encoded_size(const BencodeItem *item); // Exact size of the encoding, 0 if the item is malformed
+uint8_t *BencodeItem_to_bytes(const BencodeItem *item, size_t *out_size); // Encode into one allocation, the caller frees it
 uint8_t *BencodeItem_compute_sha1(const BencodeItem *item); // Compute the SHA1 hash of the item, useful for torrent files.
+
+// Parsed items remember where they came from, source has to be the buffer that was parsed
+const char *BencodeItem_source_span(const BencodeItem *item, const char *source, size_t source_size, size_t *out_length);
+bool BencodeItem_compute_sha1_from_source(const BencodeItem *item, const char *source, size_t source_size,
+                                          uint8_t out_hash[BENCODE_SHA1_LENGTH]); // Hashes the original bytes, no re-encoding
 #endif //BENCODE_H
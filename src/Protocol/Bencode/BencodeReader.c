@@ -0,0 +1,306 @@
+#include "BencodeReader.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+typedef enum {
+    READER_VALUE,   // Expecting the start of a value, or 'e' inside a container
+    READER_INTEGER, // Inside i...e
+    READER_LENGTH,  // Reading the length prefix of a string, up to ':'
+    READER_STRING,  // Reading string bytes
+    READER_DONE,    // A complete value was read, anything else is an error
+    READER_FAILED
+} ReaderState;
+
+typedef enum {
+    FRAME_LIST,
+    FRAME_DICT_KEY,  // Dictionary, expecting a key (or the end)
+    FRAME_DICT_VALUE // Dictionary, expecting the value for the last key
+} ReaderFrame;
+
+struct BencodeReader {
+    BencodeReaderCallbacks callbacks;
+    void *user_data;
+    ReaderState state;
+    BencodeReaderResult failure; // Why we ended up in READER_FAILED
+
+    // Open containers, innermost last
+    uint8_t frames[BENCODE_MAX_STACK_SIZE];
+    size_t depth;
+
+    // Integer and length prefix state, these can be split over chunks too
+    uint64_t number;
+    size_t digits;
+    bool negative;
+    bool leading_zero;
+
+    // String state
+    uint64_t string_length;
+    uint64_t string_offset;
+    bool reading_key;
+    char key[BENCODE_READER_MAX_KEY_LENGTH]; // Only used for keys split over two chunks
+};
+
+BencodeReader * BencodeReader_create(const BencodeReaderCallbacks *callbacks, void *user_data) {
+    BencodeReader *reader = (BencodeReader *)malloc(sizeof(BencodeReader));
+    if (reader == NULL) {
+        return NULL; // Memory allocation failed
+    }
+
+    memset(&reader->callbacks, 0, sizeof(reader->callbacks));
+    if (callbacks) {
+        reader->callbacks = *callbacks;
+    }
+    reader->user_data = user_data;
+    BencodeReader_reset(reader);
+    return reader;
+}
+
+void BencodeReader_destroy(BencodeReader *reader) {
+    free(reader);
+}
+
+void BencodeReader_reset(BencodeReader *reader) {
+    if (reader == NULL) {
+        return;
+    }
+    reader->state = READER_VALUE;
+    reader->failure = BENCODE_READER_OK;
+    reader->depth = 0;
+    reader->number = 0;
+    reader->digits = 0;
+    reader->negative = false;
+    reader->leading_zero = false;
+    reader->string_length = 0;
+    reader->string_offset = 0;
+    reader->reading_key = false;
+}
+
+static BencodeReaderResult fail(BencodeReader *reader, BencodeReaderResult failure) {
+    reader->state = READER_FAILED;
+    reader->failure = failure;
+    return failure;
+}
+
+// A value (integer, string, or a whole container) just ended
+static void value_done(BencodeReader *reader) {
+    if (reader->depth == 0) {
+        reader->state = READER_DONE;
+        return;
+    }
+    if (reader->frames[reader->depth - 1] == FRAME_DICT_VALUE) {
+        reader->frames[reader->depth - 1] = FRAME_DICT_KEY;
+    }
+    reader->state = READER_VALUE;
+}
+
+static void key_done(BencodeReader *reader) {
+    reader->frames[reader->depth - 1] = FRAME_DICT_VALUE;
+    reader->state = READER_VALUE;
+}
+
+// Handles the byte that starts a value (or closes a container). Returns false on malformed input.
+static bool start_value(BencodeReader *reader, char c, bool *aborted) {
+    ReaderFrame top = reader->depth > 0 ? (ReaderFrame)reader->frames[reader->depth - 1] : FRAME_LIST;
+    bool expecting_key = reader->depth > 0 && top == FRAME_DICT_KEY;
+
+    if (c >= '0' && c <= '9') {
+        reader->state = READER_LENGTH;
+        reader->number = 0;
+        reader->digits = 0;
+        reader->reading_key = expecting_key;
+        return true;
+    }
+
+    if (c == 'e') {
+        if (reader->depth == 0 || top == FRAME_DICT_VALUE) {
+            return false; // Nothing to close, or a key without a value
+        }
+        reader->depth--;
+        *aborted = reader->callbacks.on_end && !reader->callbacks.on_end(reader->user_data);
+        value_done(reader);
+        return true;
+    }
+
+    if (expecting_key) {
+        return false; // Keys must be strings
+    }
+
+    if (c == 'i') {
+        reader->state = READER_INTEGER;
+        reader->number = 0;
+        reader->digits = 0;
+        reader->negative = false;
+        reader->leading_zero = false;
+        return true;
+    }
+
+    if (c == 'l' || c == 'd') {
+        if (reader->depth == BENCODE_MAX_STACK_SIZE) {
+            return false; // Too deep, most likely hostile
+        }
+        reader->frames[reader->depth++] = c == 'l' ? FRAME_LIST : FRAME_DICT_KEY;
+        if (c == 'l') {
+            *aborted = reader->callbacks.on_list_start && !reader->callbacks.on_list_start(reader->user_data);
+        } else {
+            *aborted = reader->callbacks.on_dictionary_start && !reader->callbacks.on_dictionary_start(reader->user_data);
+        }
+        return true;
+    }
+
+    return false; // Invalid type
+}
+
+BencodeReaderResult BencodeReader_feed(BencodeReader *reader, const char *data, size_t size) {
+    if (reader == NULL || (data == NULL && size > 0)) {
+        return BENCODE_READER_ERROR;
+    }
+    if (reader->state == READER_FAILED) {
+        return reader->failure;
+    }
+
+    size_t pos = 0;
+    while (pos < size) {
+        char c = data[pos];
+        bool aborted = false;
+
+        switch (reader->state) {
+            case READER_VALUE:
+                if (!start_value(reader, c, &aborted)) {
+                    return fail(reader, BENCODE_READER_ERROR);
+                }
+                if (reader->state != READER_LENGTH) {
+                    pos++; // The length prefix consumes its own first digit
+                }
+                break;
+
+            case READER_INTEGER:
+                if (c == 'e') {
+                    // Empty and "-0" are invalid, leading zeros were rejected below
+                    if (reader->digits == 0 || (reader->negative && reader->leading_zero)) {
+                        return fail(reader, BENCODE_READER_ERROR);
+                    }
+                    int64_t value = reader->negative
+                        ? (int64_t)(0 - reader->number) // Two's complement, works for INT64_MIN too
+                        : (int64_t)reader->number;
+                    aborted = reader->callbacks.on_integer && !reader->callbacks.on_integer(reader->user_data, value);
+                    value_done(reader);
+                } else if (c == '-' && reader->digits == 0 && !reader->negative) {
+                    reader->negative = true;
+                } else if (c >= '0' && c <= '9') {
+                    if (reader->leading_zero) {
+                        return fail(reader, BENCODE_READER_ERROR); // i03e
+                    }
+                    uint64_t digit = (uint64_t)(c - '0');
+                    uint64_t limit = reader->negative ? (uint64_t)INT64_MAX + 1 : (uint64_t)INT64_MAX;
+                    if (reader->number > (limit - digit) / 10) {
+                        return fail(reader, BENCODE_READER_ERROR); // Doesn't fit in an int64_t
+                    }
+                    reader->leading_zero = reader->digits == 0 && digit == 0;
+                    reader->number = reader->number * 10 + digit;
+                    reader->digits++;
+                } else {
+                    return fail(reader, BENCODE_READER_ERROR);
+                }
+                pos++;
+                break;
+
+            case READER_LENGTH:
+                if (c >= '0' && c <= '9') {
+                    uint64_t digit = (uint64_t)(c - '0');
+                    if (reader->number > (UINT64_MAX - digit) / 10) {
+                        return fail(reader, BENCODE_READER_ERROR);
+                    }
+                    reader->number = reader->number * 10 + digit;
+                    reader->digits++;
+                    pos++;
+                    break;
+                }
+                if (c != ':' || reader->digits == 0) {
+                    return fail(reader, BENCODE_READER_ERROR);
+                }
+                pos++; // Skip ':'
+
+                reader->string_length = reader->number;
+                reader->string_offset = 0;
+                if (reader->reading_key && reader->string_length > BENCODE_READER_MAX_KEY_LENGTH) {
+                    return fail(reader, BENCODE_READER_ERROR);
+                }
+                if (reader->string_length > 0) {
+                    reader->state = READER_STRING;
+                    break;
+                }
+
+                // Empty strings have no bytes to wait for
+                if (reader->reading_key) {
+                    aborted = reader->callbacks.on_key && !reader->callbacks.on_key(reader->user_data, "", 0);
+                    key_done(reader);
+                } else {
+                    aborted = reader->callbacks.on_string && !reader->callbacks.on_string(reader->user_data, "", 0, 0, 0);
+                    value_done(reader);
+                }
+                break;
+
+            case READER_STRING: {
+                uint64_t remaining = reader->string_length - reader->string_offset;
+                size_t take = (uint64_t)(size - pos) < remaining ? size - pos : (size_t)remaining;
+                bool complete = take == remaining;
+
+                if (reader->reading_key) {
+                    if (reader->string_offset == 0 && complete) {
+                        // The whole key is in this chunk, no need to copy it
+                        aborted = reader->callbacks.on_key &&
+                                  !reader->callbacks.on_key(reader->user_data, data + pos, take);
+                    } else {
+                        memcpy(reader->key + reader->string_offset, data + pos, take);
+                        if (complete) {
+                            aborted = reader->callbacks.on_key &&
+                                      !reader->callbacks.on_key(reader->user_data, reader->key, (size_t)reader->string_length);
+                        }
+                    }
+                } else {
+                    aborted = reader->callbacks.on_string &&
+                              !reader->callbacks.on_string(reader->user_data, data + pos, take,
+                                                           reader->string_offset, reader->string_length);
+                }
+
+                reader->string_offset += take;
+                pos += take;
+                if (complete) {
+                    if (reader->reading_key) {
+                        key_done(reader);
+                    } else {
+                        value_done(reader);
+                    }
+                }
+                break;
+            }
+
+            case READER_DONE:
+                return fail(reader, BENCODE_READER_ERROR); // Trailing data after the document
+
+            case READER_FAILED:
+                return reader->failure;
+        }
+
+        if (aborted) {
+            return fail(reader, BENCODE_READER_ABORTED);
+        }
+    }
+
+    return reader->state == READER_DONE ? BENCODE_READER_DONE : BENCODE_READER_OK;
+}
+
+BencodeReaderResult BencodeReader_finish(const BencodeReader *reader) {
+    if (reader == NULL) {
+        return BENCODE_READER_ERROR;
+    }
+    if (reader->state == READER_FAILED) {
+        return reader->failure;
+    }
+    return reader->state == READER_DONE ? BENCODE_READER_DONE : BENCODE_READER_ERROR;
+}
+
+size_t BencodeReader_depth(const BencodeReader *reader) {
+    return reader ? reader->depth : 0;
+}
@@ -0,0 +1,44 @@
+#ifndef BENCODEREADER_H
+#define BENCODEREADER_H
+
+// Streaming (SAX-style) bencode reader. Input can be fed in chunks of any size, split anywhere,
+// and values are reported through callbacks as soon as they are complete. Nothing is buffered
+// except for dictionary keys that happen to be split over two chunks, and no tree is built.
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "Bencode.h" // For BENCODE_MAX_STACK_SIZE
+
+#define BENCODE_READER_MAX_KEY_LENGTH 4096
+
+typedef enum {
+    BENCODE_READER_OK      =  0,  // Everything fed so far is valid, waiting for more input
+    BENCODE_READER_DONE    =  1,  // A complete value was read
+    BENCODE_READER_ERROR   = -1,  // Malformed input (or nested deeper than BENCODE_MAX_STACK_SIZE)
+    BENCODE_READER_ABORTED = -2   // A callback returned false
+} BencodeReaderResult;
+
+// Every callback is optional, return false to stop reading.
+typedef struct {
+    bool (*on_integer)(void *user_data, int64_t value);
+    // Strings are passed in one call when they are inside one chunk, otherwise as consecutive fragments.
+    // The string is complete when offset + fragment_length == total_length.
+    bool (*on_string)(void *user_data, const char *fragment, size_t fragment_length, uint64_t offset, uint64_t total_length);
+    bool (*on_key)(void *user_data, const char *key, size_t length); // Dictionary keys always arrive whole
+    bool (*on_list_start)(void *user_data);
+    bool (*on_dictionary_start)(void *user_data);
+    bool (*on_end)(void *user_data); // End of the innermost open list or dictionary
+} BencodeReaderCallbacks;
+
+typedef struct BencodeReader BencodeReader;
+
+BencodeReader *BencodeReader_create(const BencodeReaderCallbacks *callbacks, void *user_data);
+void BencodeReader_destroy(BencodeReader *reader);
+void BencodeReader_reset(BencodeReader *reader); // Start over with a new document
+
+BencodeReaderResult BencodeReader_feed(BencodeReader *reader, const char *data, size_t size);
+BencodeReaderResult BencodeReader_finish(const BencodeReader *reader); // DONE if the document was complete, ERROR otherwise
+size_t BencodeReader_depth(const BencodeReader *reader); // Number of open lists/dictionaries
+
+#endif //BENCODEREADER_H
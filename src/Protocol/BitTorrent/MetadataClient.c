@@ -73,31 +73,57 @@ int hex_to_bytes(const char *hex, uint8_t *out, size_t out_len) {
     return 0;
 }
 
+// Response buffer that grows by doubling, so a response doesn't cost a realloc per curl chunk
+struct MemoryBuffer {
+    uint8_t *data;
+    size_t size;
+    size_t capacity;
+};
+
 static size_t write_to_memory(void *ptr, size_t size, size_t nmemb, void *userdata) {
     size_t total = size * nmemb;
-    struct MemoryBuffer {
-        uint8_t *data;
-        size_t size;
-    } *mem = userdata;
+    struct MemoryBuffer *mem = userdata;
 
-    uint8_t *new_data = realloc(mem->data, mem->size + total);
-    if (!new_data) return 0;
+    if (mem->size + total > mem->capacity) {
+        size_t new_capacity = mem->capacity ? mem->capacity * 2 : 4096;
+        while (new_capacity < mem->size + total) {
+            new_capacity *= 2;
+        }
+        uint8_t *new_data = realloc(mem->data, new_capacity);
+        if (!new_data) return 0;
+        mem->data = new_data;
+        mem->capacity = new_capacity;
+    }
 
-    memcpy(new_data + mem->size, ptr, total);
-    mem->data = new_data;
+    memcpy(mem->data + mem->size, ptr, total);
     mem->size += total;
 
     return total;
 }
 
+// Feeds every chunk straight into a BencodeReader, nothing is buffered
+struct ReaderSink {
+    BencodeReader *reader;
+    BencodeReaderResult result;
+};
+
+static size_t write_to_reader(void *ptr, size_t size, size_t nmemb, void *userdata) {
+    size_t total = size * nmemb;
+    struct ReaderSink *sink = userdata;
+
+    sink->result = BencodeReader_feed(sink->reader, (const char *)ptr, total);
+    return sink->result < 0 ? 0 : total; // Anything short of total makes curl stop the transfer
+}
+
 void url_encode(const uint8_t *src, size_t len, char *dest) {
     for (size_t i = 0; i < len; i++) {
         sprintf(dest + 3*i, "%%%02X", src[i]);
     }
 }
 
-MetadataResult MetadataClient_announce(
-    MetadataClient* client,
+static MetadataResult build_announce_url(
+    char*           full_url,
+    size_t          full_url_size,
     const char*     url,
     const char*     info_hash_hex,
     const char*     peer_id,
@@ -107,13 +133,9 @@ MetadataResult MetadataClient_announce(
     uint64_t        left,
     const char *    event,
     uint32_t        num_want,
-    uint32_t        compact,
-    uint8_t**       out_buffer,
-    size_t*         out_size)
+    uint32_t        compact)
 {
     if (!info_hash_hex || strlen(info_hash_hex) != 40) return METADATA_ERROR_INVALID;
-    if (!out_buffer || !out_size) return METADATA_ERROR_INVALID;
-
 
     // Convert info_hash_hex to raw bytes
     uint8_t info_hash_raw[INFO_HASH_LEN];
@@ -121,32 +143,30 @@ MetadataResult MetadataClient_announce(
         return METADATA_ERROR_INVALID;
 
     // URL-encode info_hash and peer_id
-    char encoded_info_hash[INFO_HASH_LEN * 2 + 1];
+    char encoded_info_hash[INFO_HASH_LEN * 3 + 1];
     url_encode(info_hash_raw, INFO_HASH_LEN, encoded_info_hash);
     // Use standard BitTorrent port range
     listen_port = (listen_port >= 6881 && listen_port <= 6889)
                   ? listen_port : 6881;
     // Build full URL with query parameters
-    char full_url[2048];
-    snprintf(full_url, sizeof(full_url),
+    snprintf(full_url, full_url_size,
              "%s?info_hash=%s&peer_id=%s&port=%llu&uploaded=%llu&downloaded=%llu&left=%llu&event=%s&numwant=%u&compact=%u",
              url,
              encoded_info_hash,
              peer_id,
-             listen_port,
-             uploaded,
-             downloaded,
-             left,
+             (unsigned long long)listen_port,
+             (unsigned long long)uploaded,
+             (unsigned long long)downloaded,
+             (unsigned long long)left,
              event ? event : "started",
              num_want,
              compact);
+    return METADATA_OK;
+}
 
-    // Prepare memory buffer for response
-    struct MemoryBuffer {
-        uint8_t *data;
-        size_t size;
-    } mem = {0};
-
+static MetadataResult perform_get(MetadataClient* client, const char* full_url,
+                                  size_t (*write_fn)(void *, size_t, size_t, void *), void* write_data)
+{
     // Set CURL options
     curl_easy_setopt(client->curl_handle, CURLOPT_URL, full_url);
     curl_easy_setopt(client->curl_handle, CURLOPT_HTTPGET, 1L);
@@ -159,22 +179,53 @@ MetadataResult MetadataClient_announce(
     curl_easy_setopt(client->curl_handle, CURLOPT_SSL_VERIFYPEER, 0L); // Only for dev
 
     // Set up write callback
-    curl_easy_setopt(client->curl_handle, CURLOPT_WRITEFUNCTION, write_to_memory);
-    curl_easy_setopt(client->curl_handle, CURLOPT_WRITEDATA, &mem);
+    curl_easy_setopt(client->curl_handle, CURLOPT_WRITEFUNCTION, write_fn);
+    curl_easy_setopt(client->curl_handle, CURLOPT_WRITEDATA, write_data);
 
     CURLcode res = curl_easy_perform(client->curl_handle);
     if (res != CURLE_OK) {
         fprintf(stderr, "curl_easy_perform() failed: %s\n", curl_easy_strerror(res));
-        if (mem.data) free(mem.data);
         return METADATA_ERROR_CURL;
     }
 
     long http_code = 0;
     curl_easy_getinfo(client->curl_handle, CURLINFO_RESPONSE_CODE, &http_code);
     if (http_code < 200 || http_code >= 300) {
-        if (mem.data) free(mem.data);
         return METADATA_ERROR_HTTP;
     }
+    return METADATA_OK;
+}
+
+MetadataResult MetadataClient_announce(
+    MetadataClient* client,
+    const char*     url,
+    const char*     info_hash_hex,
+    const char*     peer_id,
+    uint64_t        listen_port,
+    uint64_t        uploaded,
+    uint64_t        downloaded,
+    uint64_t        left,
+    const char *    event,
+    uint32_t        num_want,
+    uint32_t        compact,
+    uint8_t**       out_buffer,
+    size_t*         out_size)
+{
+    if (!out_buffer || !out_size) return METADATA_ERROR_INVALID;
+
+    char full_url[2048];
+    MetadataResult result = build_announce_url(full_url, sizeof(full_url), url, info_hash_hex, peer_id,
+                                               listen_port, uploaded, downloaded, left, event, num_want, compact);
+    if (result != METADATA_OK) return result;
+
+    // Prepare memory buffer for response
+    struct MemoryBuffer mem = {0};
+
+    result = perform_get(client, full_url, write_to_memory, &mem);
+    if (result != METADATA_OK) {
+        if (mem.data) free(mem.data);
+        return result;
+    }
 
     *out_buffer = mem.data;
     *out_size = mem.size;
@@ -197,3 +248,41 @@ MetadataResult MetadataClient_announce(
     }
     return METADATA_OK;
 }
+
+MetadataResult MetadataClient_announce_stream(
+    MetadataClient* client,
+    const char*     url,
+    const char*     info_hash_hex,
+    const char*     peer_id,
+    uint64_t        listen_port,
+    uint64_t        uploaded,
+    uint64_t        downloaded,
+    uint64_t        left,
+    const char *    event,
+    uint32_t        num_want,
+    uint32_t        compact,
+    const BencodeReaderCallbacks* callbacks,
+    void*           user_data)
+{
+    if (!callbacks) return METADATA_ERROR_INVALID;
+
+    char full_url[2048];
+    MetadataResult result = build_announce_url(full_url, sizeof(full_url), url, info_hash_hex, peer_id,
+                                               listen_port, uploaded, downloaded, left, event, num_want, compact);
+    if (result != METADATA_OK) return result;
+
+    struct ReaderSink sink = { .reader = BencodeReader_create(callbacks, user_data), .result = BENCODE_READER_OK };
+    if (!sink.reader) return METADATA_ERROR_MEM;
+
+    result = perform_get(client, full_url, write_to_reader, &sink);
+    if (sink.result == BENCODE_READER_ABORTED) {
+        result = METADATA_OK; // A callback had what it needed and stopped the transfer
+    } else if (sink.result == BENCODE_READER_ERROR) {
+        result = METADATA_ERROR_INVALID;
+    } else if (result == METADATA_OK && BencodeReader_finish(sink.reader) != BENCODE_READER_DONE) {
+        result = METADATA_ERROR_INVALID; // Truncated response
+    }
+
+    BencodeReader_destroy(sink.reader);
+    return result;
+}
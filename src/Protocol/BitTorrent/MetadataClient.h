@@ -4,6 +4,7 @@
 #include <stdlib.h>
 #include <stdint.h>
 #include <stdbool.h>
+#include <BencodeReader.h>
 
 #define CLIENT_PREFIX "-CT0010-"
 #define PEER_ID_LEN 20  // Length of the peer ID string
@@ -50,4 +51,22 @@ MetadataResult MetadataClient_announce(
     size_t*         out_size
 );
 
+/// Same as MetadataClient_announce, but the response is decoded while it arrives instead of being buffered.
+/// A callback returning false stops the transfer early (still METADATA_OK), malformed responses give METADATA_ERROR_INVALID.
+MetadataResult MetadataClient_announce_stream(
+    MetadataClient* client,
+    const char*     url,
+    const char*     info_hash,
+    const char*     peer_id,
+    uint64_t        listen_port,
+    uint64_t        uploaded,
+    uint64_t        downloaded,
+    uint64_t        left,
+    const char *event,
+    uint32_t        num_want,
+    uint32_t        compact,
+    const BencodeReaderCallbacks* callbacks,
+    void*           user_data
+);
+
 #endif //METADATACLIENT_H
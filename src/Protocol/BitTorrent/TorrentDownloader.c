@@ -3,81 +3,151 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#include <CommonCrypto/CommonDigest.h>
+#include <CoreSha1.h>
 #include <CoreNetworking.h> // for test_network
 #include <MetadataClient.h>
+#include "TorrentPieceHasher.h"
 
-// Helper to lookup dictionary entries
-static BencodeItem* get_dict_value(BencodeDictionary* dict, const char* key) {
-    for (size_t i = 0; i < dict->count; i++) {
-        if (strcmp(dict->keys[i]->str, key) == 0)
-            return dict->values[i];
+// A path component from the torrent must stay inside the download directory
+static bool is_safe_component(const CoreString *component) {
+    if (component->length == 0 || memchr(component->str, '/', component->length) || memchr(component->str, '\0', component->length))
+        return false;
+    return !(component->length == 1 && component->str[0] == '.') &&
+           !(component->length == 2 && component->str[0] == '.' && component->str[1] == '.');
+}
+
+// Joins output_path, name and the components of a "path" list (if any) with '/'
+static char *join_file_path(const char *output_path, const CoreString *name, const BencodeList *components) {
+    size_t length = strlen(output_path) + 1 + name->length;
+    for (size_t i = 0; components && i < components->count; i++) {
+        if (components->items[i].type != BENCODE_TYPE_STRING || !is_safe_component(components->items[i].value.string))
+            return NULL;
+        length += 1 + components->items[i].value.string->length;
     }
-    return NULL;
+
+    char *path = malloc(length + 1);
+    if (!path) return NULL;
+    char *cursor = path + sprintf(path, "%s/", output_path);
+    memcpy(cursor, name->str, name->length);
+    cursor += name->length;
+    for (size_t i = 0; components && i < components->count; i++) {
+        const CoreString *component = components->items[i].value.string;
+        *cursor++ = '/';
+        memcpy(cursor, component->str, component->length);
+        cursor += component->length;
+    }
+    *cursor = '\0';
+    return path;
 }
 
-// Compute SHA1 hex string of a file at 'path'
-static char* compute_sha1(const char* path) {
-    FILE *f = fopen(path, "rb");
-    if (!f) return NULL;
+// Fills the file table from "length" (single-file) or "files" (multi-file), false if it's malformed
+static bool read_files(TorrentDownloader *dl, BencodeDictionary *infod) {
+    BencodeItem *name = BencodeDictionary_get(infod, "name");
+    if (!name || name->type != BENCODE_TYPE_STRING || !is_safe_component(name->value.string))
+        return false;
 
-    CC_SHA1_CTX ctx;
-    CC_SHA1_Init(&ctx);
+    BencodeList *files = BencodeItem_get_list(BencodeDictionary_get(infod, "files"));
+    size_t count = files ? files->count : 1;
+    if (count == 0 || count > INT32_MAX) return false;
+    dl->info.files = calloc(count, sizeof(TorrentFileInfo));
+    if (!dl->info.files) return false;
+    dl->info.file_count = (int)count;
 
-    unsigned char buf[8192];
-    size_t n;
-    while ((n = fread(buf, 1, sizeof(buf), f)) > 0) {
-        CC_SHA1_Update(&ctx, buf, (CC_LONG)n);
+    uint64_t offset = 0;
+    for (size_t i = 0; i < count; i++) {
+        TorrentFileInfo *file = &dl->info.files[i];
+        BencodeItem *length;
+        BencodeList *components = NULL;
+        if (files) {
+            BencodeDictionary *entry = BencodeItem_get_dictionary(&files->items[i]);
+            if (!entry) return false;
+            length = BencodeDictionary_get(entry, "length");
+            components = BencodeItem_get_list(BencodeDictionary_get(entry, "path"));
+            if (!components || components->count == 0) return false;
+        } else {
+            length = BencodeDictionary_get(infod, "length");
+        }
+        if (!length || length->type != BENCODE_TYPE_INTEGER || length->value.integer < 0) return false;
+
+        file->path = join_file_path(dl->output_path, name->value.string, components);
+        if (!file->path) return false;
+        file->file_name = components ? components->items[components->count - 1].value.string->str : name->value.string->str;
+        file->file_size = (uint64_t)length->value.integer;
+        file->offset = offset;
+        if (file->file_size > UINT64_MAX - offset) return false;
+        offset += file->file_size;
     }
-    fclose(f);
+    dl->info.total_size = offset;
+    return true;
+}
 
-    unsigned char hash[CC_SHA1_DIGEST_LENGTH];
-    CC_SHA1_Final(hash, &ctx);
+// Piece hashes are only kept if there's exactly one per piece of the payload
+static void read_pieces(TorrentDownloader *dl, BencodeDictionary *infod) {
+    BencodeItem *piece_length = BencodeDictionary_get(infod, "piece length");
+    BencodeItem *pieces = BencodeDictionary_get(infod, "pieces");
+    if (!piece_length || piece_length->type != BENCODE_TYPE_INTEGER || piece_length->value.integer <= 0) return;
+    if (!pieces || pieces->type != BENCODE_TYPE_STRING) return;
+
+    uint64_t length = (uint64_t)piece_length->value.integer;
+    uint64_t count = dl->info.total_size / length + (dl->info.total_size % length != 0);
+    if (pieces->value.string->length / CORE_SHA1_DIGEST_LENGTH != count ||
+        pieces->value.string->length % CORE_SHA1_DIGEST_LENGTH != 0)
+        return;
 
-    char* hex = malloc(2 * CC_SHA1_DIGEST_LENGTH + 1);
-    if (!hex) return NULL;
-    for (int i = 0; i < CC_SHA1_DIGEST_LENGTH; i++) {
-        sprintf(hex + i*2, "%02x", hash[i]);
-    }
-    hex[2*CC_SHA1_DIGEST_LENGTH] = '\0';
-    return hex;
+    dl->info.piece_length = length;
+    dl->info.piece_hashes = (const uint8_t *)pieces->value.string->str;
+    dl->info.piece_count = (size_t)count;
 }
 
 TorrentDownloader* TorrentDownloader_create(BencodeItem* torrent_item,
                                             const char* output_path) {
-    if (!torrent_item || torrent_item->type != BENCODE_TYPE_DICTIONARY)
+    return TorrentDownloader_create_with_source(torrent_item, NULL, 0, output_path);
+}
+
+TorrentDownloader* TorrentDownloader_create_with_source(BencodeItem* torrent_item,
+                                                        const char* source, size_t source_size,
+                                                        const char* output_path) {
+    // The accessors decode lazily parsed torrents as we go, only the fields we touch get decoded
+    BencodeDictionary *meta = BencodeItem_get_dictionary(torrent_item);
+    if (!meta)
         return NULL;
 
     TorrentDownloader *dl = calloc(1, sizeof(*dl));
     dl->output_path = strdup(output_path);
-    dl->info.meta    = torrent_item->value.dictionary;
+    dl->info.meta    = meta;
 
     // Inspect “info” section
-    BencodeItem *info = get_dict_value(dl->info.meta, "info");
-    if (info && info->type == BENCODE_TYPE_DICTIONARY) {
-        BencodeDictionary *infod = info->value.dictionary;
-        if (get_dict_value(infod, "files")) {
-            dl->info.type = TORRENT_MULTI_FILE;  // unsupported
+    BencodeItem *info = BencodeDictionary_get(dl->info.meta, "info");
+    BencodeDictionary *infod = BencodeItem_get_dictionary(info);
+    if (infod) {
+        dl->info.type = BencodeDictionary_get(infod, "files") ? TORRENT_MULTI_FILE : TORRENT_SINGLE_FILE;
+        if (!read_files(dl, infod)) {
+            TorrentDownloader_destroy(dl);
+            return NULL;
+        }
+        read_pieces(dl, infod);
+
+        // The info-hash is defined over the original bytes, only re-encode when we don't have them
+        if (BencodeItem_compute_sha1_from_source(info, source, source_size, dl->info.info_hash)) {
+            dl->info.has_info_hash = true;
         } else {
-            dl->info.type      = TORRENT_SINGLE_FILE;
-            dl->info.file_count = 1;
-            dl->info.files      = calloc(1, sizeof(TorrentFileInfo));
-            BencodeItem *name   = get_dict_value(infod, "name");
-            BencodeItem *length = get_dict_value(infod, "length");
-            dl->info.files[0].file_name = name->value.string->str;
-            dl->info.files[0].file_size = length->value.integer;
-            // Get the sha1 hash from the piece
+            uint8_t *hash = BencodeItem_compute_sha1(info);
+            if (hash) {
+                memcpy(dl->info.info_hash, hash, BENCODE_SHA1_LENGTH);
+                dl->info.has_info_hash = true;
+                free(hash);
+            }
         }
     } else {
         dl->info.type = TORRENT_UNKNOWN;
     }
 
     // DDL vs tracker
-    if (get_dict_value(dl->info.meta, "url-list")) {
+    if (BencodeDictionary_get(dl->info.meta, "url-list")) {
         dl->is_ddl = true;
     } else {
         dl->is_ddl = false;
-        BencodeItem* ann = get_dict_value(dl->info.meta, "announce");
+        BencodeItem* ann = BencodeDictionary_get(dl->info.meta, "announce");
         dl->url = ann ? ann->value.string->str : NULL;
     }
 
@@ -87,6 +157,9 @@ TorrentDownloader* TorrentDownloader_create(BencodeItem* torrent_item,
 void TorrentDownloader_destroy(TorrentDownloader* dl) {
     if (!dl) return;
     free(dl->output_path);
+    for (int i = 0; dl->info.files && i < dl->info.file_count; i++) {
+        free(dl->info.files[i].path);
+    }
     free(dl->info.files);
     free(dl);
 }
@@ -107,12 +180,13 @@ void TorrentDownloader_print_info(const TorrentDownloader* dl) {
 }
 
 const char* test_network(BencodeItem *url_list, const char* file_name, uint64_t file_size) {
-    if (!url_list || url_list->type != BENCODE_TYPE_LIST) {
+    BencodeList *urls = BencodeItem_get_list(url_list);
+    if (!urls) {
         printf("Invalid 'url-list'\n");
         return NULL;
     }
 
-    size_t count = url_list->value.list->count;
+    size_t count = urls->count;
     printf("Found %zu URLs\n", count);
     if (!count) return NULL;
     if (count > MAX_TEST_NETWORK) {
@@ -127,7 +201,7 @@ const char* test_network(BencodeItem *url_list, const char* file_name, uint64_t
     }
 
     for (size_t i = 0; i < count; i++) {
-        BencodeItem *url_item = &url_list->value.list->items[i];
+        BencodeItem *url_item = &urls->items[i];
         if (url_item->type != BENCODE_TYPE_STRING) {
             printf("Skipping invalid URL at %zu\n", i);
             continue;
@@ -195,9 +269,89 @@ const char* test_network(BencodeItem *url_list, const char* file_name, uint64_t
     return fastest_urls[0]; // Return the first fastest URL
 }
 
+#define DDL_MAX_ATTEMPTS 3 // Fetches of the same piece before giving up on it
+
+typedef struct {
+    TorrentPieceHasher hasher;
+    CoreFile *out;
+    bool piece_failed;   // The transfer was aborted because failed_piece didn't match
+    size_t failed_piece;
+    size_t retry_piece;  // Piece the last restart began at
+    unsigned attempts;   // Restarts at retry_piece so far
+    size_t bad_pieces;   // Pieces kept despite failing DDL_MAX_ATTEMPTS times
+} DdlStream;
+
+// Writes each chunk as it arrives and checks pieces as they complete, a bad piece aborts the transfer so it can be re-fetched
+static bool ddl_on_data(const uint8_t *data, size_t size, void *user_data) {
+    DdlStream *stream = user_data;
+    if (CoreFile_write(stream->out, data, size) != size) return false;
+
+    while (size > 0) {
+        TorrentPieceStatus status;
+        size_t piece;
+        size_t taken = TorrentPieceHasher_update(&stream->hasher, data, size, &status, &piece);
+        if (taken == 0) break; // Past the end of the payload
+        data += taken;
+        size -= taken;
+
+        if (status == TORRENT_PIECE_INVALID) {
+            if (piece != stream->retry_piece || stream->attempts < DDL_MAX_ATTEMPTS) {
+                printf("\nPiece %zu failed the hash check, fetching it again\n", piece);
+                stream->piece_failed = true;
+                stream->failed_piece = piece;
+                return false;
+            }
+            printf("\nPiece %zu failed the hash check %d times, keeping it\n", piece, DDL_MAX_ATTEMPTS);
+            stream->bad_pieces++;
+        }
+    }
+    return true;
+}
+
+// Streams the file from url, restarting with a Range request at the first byte of any piece that fails
+// or wherever the connection dropped. Every piece is verified on arrival, none are read back.
+static bool download_verified(const TorrentDownloader *dl, const CoreNetworkingDownloadOptions *opts, CoreFile *out) {
+    const TorrentInfo *info = &dl->info;
+    DdlStream stream = { .out = out, .retry_piece = SIZE_MAX };
+    uint64_t start = 0;
+
+    for (;;) {
+        TorrentPieceHasher_init(&stream.hasher, info, start);
+        stream.piece_failed = false;
+        if (fseek(out->file, (long)start, SEEK_SET) != 0) return false;
+
+        bool finished = CoreNetworking_download_stream(opts, start, ddl_on_data, &stream);
+        if (finished && stream.hasher.position >= info->total_size) break;
+        if (finished) {
+            fprintf(stderr, "\nServer sent %llu of %llu bytes\n",
+                    (unsigned long long)stream.hasher.position, (unsigned long long)info->total_size);
+        }
+
+        // Partial pieces can't be resumed, the hash state is gone, so restart at the piece boundary
+        size_t piece = stream.piece_failed ? stream.failed_piece : (size_t)(stream.hasher.position / info->piece_length);
+        if (piece == stream.retry_piece) {
+            if (++stream.attempts > DDL_MAX_ATTEMPTS) {
+                fprintf(stderr, "Giving up on piece %zu\n", piece);
+                return false;
+            }
+        } else {
+            stream.retry_piece = piece;
+            stream.attempts = 1;
+        }
+        start = (uint64_t)piece * info->piece_length;
+    }
+
+    printf("\n%zu/%zu pieces verified\n", info->piece_count - stream.bad_pieces, info->piece_count);
+    return stream.bad_pieces == 0;
+}
+
 bool download_as_ddl(TorrentDownloader *dl) {
+    if (dl->info.type != TORRENT_SINGLE_FILE) {
+        printf("DDL is only supported for single-file torrents\n");
+        return true;
+    }
     BencodeItem* url_list =
-            get_dict_value(dl->info.meta, "url-list");
+            BencodeDictionary_get(dl->info.meta, "url-list");
     const char* fastest =
             test_network(url_list,
                          dl->info.files[0].file_name,
@@ -208,11 +362,7 @@ bool download_as_ddl(TorrentDownloader *dl) {
     }
     printf("Using fastest URL: %s\n", fastest);
 
-    // Build output path
-    char outpath[1024];
-    snprintf(outpath, sizeof(outpath), "%s/%s",
-             dl->output_path, dl->info.files[0].file_name);
-
+    const char *outpath = dl->info.files[0].path;
     CoreFile *out = CoreFile_create(outpath, "wb+");
     if (!out) {
         fprintf(stderr, "Cannot create %s\n", outpath);
@@ -226,41 +376,51 @@ bool download_as_ddl(TorrentDownloader *dl) {
         .user_agent       = "cTorrent/0.1"
     };
 
-    if (!CoreNetworking_download_to_file(&opts, out)) {
-        fprintf(stderr, "Download failed\n");
+    if (!dl->info.piece_hashes) {
+        // Nothing to verify against, just store it
+        printf("No piece hashes, downloading without verification\n");
+        if (!CoreNetworking_download_to_file(&opts, out)) {
+            fprintf(stderr, "Download failed\n");
+            CoreFile_close(out);
+            return true;
+        }
+        CoreFile_flush(out);
         CoreFile_close(out);
-        return true;
+        return false;
     }
+
+    bool failed = !download_verified(dl, &opts, out);
     CoreFile_flush(out);
     CoreFile_close(out);
-    return false;
+    return failed;
 }
 
 bool download_as_tracker(TorrentDownloader * dl) {
     // Get the info hash and the url
-    BencodeItem *info = get_dict_value(dl->info.meta, "info");
-    if (!info || info->type != BENCODE_TYPE_DICTIONARY) {
+    BencodeDictionary *infod = BencodeItem_get_dictionary(BencodeDictionary_get(dl->info.meta, "info"));
+    if (!infod) {
         fprintf(stderr, "Invalid torrent metadata\n");
         return false;
     }
-    BencodeDictionary *infod = info->value.dictionary;
-    BencodeItem *name = get_dict_value(infod, "name");
+    BencodeItem *name = BencodeDictionary_get(infod, "name");
     if (!name || name->type != BENCODE_TYPE_STRING) {
         fprintf(stderr, "Torrent name not found\n");
         return false;
     }
 
-    uint8_t* info_hash = BencodeItem_compute_sha1(info);
+    if (!dl->info.has_info_hash) {
+        fprintf(stderr, "Could not compute the info hash\n");
+        return false;
+    }
+    const uint8_t* info_hash = dl->info.info_hash;
 
-    // Q: How do we get the info hash?
-    char hex[CC_SHA1_DIGEST_LENGTH*2 + 1];
-    for (int i = 0; i < CC_SHA1_DIGEST_LENGTH; i++)
+    char hex[CORE_SHA1_DIGEST_LENGTH*2 + 1];
+    for (int i = 0; i < CORE_SHA1_DIGEST_LENGTH; i++)
         sprintf(hex + i*2, "%02x", info_hash[i]);
-    hex[CC_SHA1_DIGEST_LENGTH*2] = '\0';
+    hex[CORE_SHA1_DIGEST_LENGTH*2] = '\0';
     printf("Info hash: %s\n", hex);
     if (dl->url == NULL) {
         fprintf(stderr, "No tracker URL found\n");
-        free(info_hash);
         return false;
     }
     printf("Tracker URL: %s\n", dl->url);
@@ -276,7 +436,6 @@ bool download_as_tracker(TorrentDownloader * dl) {
     MetadataClient* client = MetadataClient_create(&opts);
     if (!client) {
         fprintf(stderr, "Failed to create MetadataClient\n");
-        free(info_hash);
         return false;
     }
 
@@ -297,7 +456,6 @@ void TorrentDownloader_download(TorrentDownloader* dl) {
         return;
     }
 
-    if (download_as_ddl(dl)) return;
-
-    // TODO: Implement a hash check (idk how to do this yet)
+    // Pieces are verified while they download, see download_verified
+    if (download_as_ddl(dl)) printf("DDL download failed\n");
 }
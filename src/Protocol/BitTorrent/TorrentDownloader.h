@@ -21,6 +21,8 @@ typedef struct {
     const char* file_name;
     uint64_t file_size; // in bytes
     char* hash; // SHA1 hash of the file
+    char* path; // Where the file goes on disk: output_path/name for single-file, output_path/name/dirs.../file for multi-file
+    uint64_t offset; // Where the file starts in the torrent's payload (all files back to back)
 } TorrentFileInfo;
 
 typedef struct {
@@ -29,6 +31,12 @@ typedef struct {
     TorrentFileInfo *files; // array of files in the torrent
     int file_count; // number of files in the torrent
     TorrentType type;
+    uint8_t info_hash[BENCODE_SHA1_LENGTH]; // SHA1 of the bencoded info dictionary
+    bool has_info_hash;
+    uint64_t total_size; // Sum of all file sizes
+    uint64_t piece_length;
+    const uint8_t *piece_hashes; // piece_count SHA1 digests, points into meta. NULL if "pieces" is missing or the wrong size
+    size_t piece_count;
 } TorrentInfo;
 
 typedef struct {
@@ -40,6 +48,10 @@ typedef struct {
 
 // Initialise the torrent downloader with a bencode item!
 TorrentDownloader *TorrentDownloader_create(BencodeItem *torrent_item, const char* output_path);
+// Same as above, but takes the buffer torrent_item was parsed from, so the info-hash is taken from the original bytes.
+// The buffer is only used during this call.
+TorrentDownloader *TorrentDownloader_create_with_source(BencodeItem *torrent_item, const char *source, size_t source_size,
+                                                        const char* output_path);
 void TorrentDownloader_destroy(TorrentDownloader *downloader);
 
 void TorrentDownloader_print_info(const TorrentDownloader *downloader);
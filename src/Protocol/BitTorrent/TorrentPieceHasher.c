@@ -0,0 +1,34 @@
+// TorrentPieceHasher.c
+#include "TorrentPieceHasher.h"
+#include <string.h>
+
+void TorrentPieceHasher_init(TorrentPieceHasher *hasher, const TorrentInfo *info, uint64_t start) {
+    hasher->info = info;
+    hasher->position = start;
+    CoreSha1_init(&hasher->sha);
+}
+
+size_t TorrentPieceHasher_update(TorrentPieceHasher *hasher, const uint8_t *data, size_t size,
+                                 TorrentPieceStatus *status, size_t *piece) {
+    const TorrentInfo *info = hasher->info;
+    *status = TORRENT_PIECE_PENDING;
+    if (hasher->position >= info->total_size) return 0; // Anything past the payload is ignored
+
+    size_t index = (size_t)(hasher->position / info->piece_length);
+    uint64_t piece_end = (uint64_t)(index + 1) * info->piece_length;
+    if (piece_end > info->total_size) piece_end = info->total_size;
+
+    size_t taken = piece_end - hasher->position < size ? (size_t)(piece_end - hasher->position) : size;
+    CoreSha1_update(&hasher->sha, data, taken);
+    hasher->position += taken;
+
+    if (hasher->position == piece_end) {
+        uint8_t digest[CORE_SHA1_DIGEST_LENGTH];
+        CoreSha1_final(&hasher->sha, digest);
+        CoreSha1_init(&hasher->sha);
+        const uint8_t *expected = info->piece_hashes + (size_t)index * CORE_SHA1_DIGEST_LENGTH;
+        *status = memcmp(digest, expected, CORE_SHA1_DIGEST_LENGTH) == 0 ? TORRENT_PIECE_VALID : TORRENT_PIECE_INVALID;
+        *piece = index;
+    }
+    return taken;
+}
@@ -0,0 +1,32 @@
+#ifndef TORRENTPIECEHASHER_H
+#define TORRENTPIECEHASHER_H
+
+// Hashes payload bytes as they arrive (in order) and checks every piece against info.pieces
+// the moment its last byte comes in, so nothing has to be read back from disk.
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <CoreSha1.h>
+#include "TorrentDownloader.h"
+
+typedef enum {
+    TORRENT_PIECE_PENDING, // The current piece isn't complete yet
+    TORRENT_PIECE_VALID,
+    TORRENT_PIECE_INVALID
+} TorrentPieceStatus;
+
+typedef struct {
+    const TorrentInfo *info;
+    uint64_t position; // Payload offset of the next byte
+    CoreSha1 sha;      // Over the current piece so far
+} TorrentPieceHasher;
+
+// start must be the first byte of a piece
+void TorrentPieceHasher_init(TorrentPieceHasher *hasher, const TorrentInfo *info, uint64_t start);
+// Consumes bytes up to the end of the current piece at most and returns how many it took. When that
+// completes the piece, *status says whether it matched and *piece which one it was.
+size_t TorrentPieceHasher_update(TorrentPieceHasher *hasher, const uint8_t *data, size_t size,
+                                 TorrentPieceStatus *status, size_t *piece);
+
+#endif //TORRENTPIECEHASHER_H
@@ -0,0 +1,177 @@
+// TorrentRecheck.c
+#include "TorrentRecheck.h"
+#include <stdlib.h>
+#include <string.h>
+#include <stdatomic.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <CoreSha1.h>
+#include <CoreThreadPool.h>
+
+#define RECHECK_DEFAULT_READ_SIZE (4 * 1024 * 1024)
+#define RECHECK_MAX_BATCH 16 // Pieces per CoreSha1_hash_many call, fills every AVX-512 lane
+#define RECHECK_ALIGNMENT 4096
+
+typedef struct {
+    const TorrentInfo *info;
+    int *fds; // One per file, -1 if it couldn't be opened
+    size_t batch_pieces;
+    size_t batch_count;
+    atomic_size_t next_batch;
+    uint8_t *valid; // One byte per piece, workers never share a byte so no locking is needed
+} RecheckJob;
+
+// Index of the file containing payload offset (the last one starting at or before it)
+static size_t find_file(const TorrentInfo *info, uint64_t offset) {
+    size_t low = 0;
+    size_t high = (size_t)info->file_count;
+    while (high - low > 1) {
+        size_t middle = low + (high - low) / 2;
+        if (info->files[middle].offset <= offset) low = middle;
+        else high = middle;
+    }
+    return low;
+}
+
+static bool read_fully(int fd, uint8_t *buffer, size_t size, uint64_t offset) {
+    while (size > 0) {
+        ssize_t n = pread(fd, buffer, size, (off_t)offset);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return false;
+        buffer += n;
+        size -= (size_t)n;
+        offset += (uint64_t)n;
+    }
+    return true;
+}
+
+// Reads payload bytes [start, start + size) across however many files they cover.
+// Pieces touching a range that couldn't be read are marked broken.
+static void read_range(const RecheckJob *job, uint8_t *buffer, uint64_t start, size_t size, bool *broken) {
+    const TorrentInfo *info = job->info;
+    uint64_t position = start;
+    uint64_t end = start + size;
+    for (size_t f = find_file(info, start); position < end && f < (size_t)info->file_count; f++) {
+        const TorrentFileInfo *file = &info->files[f];
+        uint64_t file_end = file->offset + file->file_size;
+        if (file_end <= position) continue; // Empty files
+        uint64_t segment_end = file_end < end ? file_end : end;
+
+        if (job->fds[f] < 0 ||
+            !read_fully(job->fds[f], buffer + (position - start), (size_t)(segment_end - position), position - file->offset)) {
+            size_t first = (size_t)((position - start) / info->piece_length);
+            size_t last = (size_t)((segment_end - 1 - start) / info->piece_length);
+            for (size_t p = first; p <= last; p++) {
+                broken[p] = true;
+            }
+        }
+        position = segment_end;
+    }
+}
+
+static void recheck_worker(void *argument) {
+    RecheckJob *job = argument;
+    const TorrentInfo *info = job->info;
+    uint8_t *buffer = NULL;
+    if (posix_memalign((void **)&buffer, RECHECK_ALIGNMENT, job->batch_pieces * info->piece_length) != 0) return;
+
+    size_t batch;
+    while ((batch = atomic_fetch_add(&job->next_batch, 1)) < job->batch_count) {
+        size_t first = batch * job->batch_pieces;
+        size_t count = info->piece_count - first < job->batch_pieces ? info->piece_count - first : job->batch_pieces;
+        uint64_t start = (uint64_t)first * info->piece_length;
+        uint64_t end = start + (uint64_t)count * info->piece_length;
+        if (end > info->total_size) end = info->total_size;
+
+        bool broken[RECHECK_MAX_BATCH] = { false };
+        read_range(job, buffer, start, (size_t)(end - start), broken);
+
+        // Only the torrent's last piece can be short, hash the full ones side by side
+        const uint8_t *pieces[RECHECK_MAX_BATCH];
+        uint8_t digests[RECHECK_MAX_BATCH][CORE_SHA1_DIGEST_LENGTH];
+        for (size_t i = 0; i < count; i++) {
+            pieces[i] = buffer + i * info->piece_length;
+        }
+        size_t full = (size_t)((end - start) / info->piece_length);
+        CoreSha1_hash_many(pieces, info->piece_length, full, digests);
+        if (full < count) {
+            CoreSha1_hash(pieces[full], (size_t)(end - start - full * info->piece_length), digests[full]);
+        }
+
+        for (size_t i = 0; i < count; i++) {
+            const uint8_t *expected = info->piece_hashes + (first + i) * CORE_SHA1_DIGEST_LENGTH;
+            job->valid[first + i] = !broken[i] && memcmp(digests[i], expected, CORE_SHA1_DIGEST_LENGTH) == 0;
+        }
+    }
+    free(buffer);
+}
+
+bool TorrentRecheck_run(const TorrentInfo *info, const TorrentRecheckOptions *options, TorrentRecheckResult *result) {
+    if (!info || !result || !info->piece_hashes || info->piece_count == 0 || info->file_count <= 0) return false;
+    memset(result, 0, sizeof(*result));
+
+    TorrentRecheckOptions defaults = { 0 };
+    if (!options) options = &defaults;
+    size_t read_size = options->read_size ? options->read_size : RECHECK_DEFAULT_READ_SIZE;
+
+    RecheckJob job = { .info = info };
+    job.batch_pieces = read_size / info->piece_length;
+    if (job.batch_pieces == 0) job.batch_pieces = 1;
+    if (job.batch_pieces > RECHECK_MAX_BATCH) job.batch_pieces = RECHECK_MAX_BATCH;
+    job.batch_count = (info->piece_count + job.batch_pieces - 1) / job.batch_pieces;
+    atomic_init(&job.next_batch, 0);
+
+    job.valid = calloc(info->piece_count, 1);
+    job.fds = malloc((size_t)info->file_count * sizeof(int));
+    result->bitfield = calloc((info->piece_count + 7) / 8, 1);
+    if (!job.valid || !job.fds || !result->bitfield) {
+        free(job.valid);
+        free(job.fds);
+        TorrentRecheck_result_free(result);
+        return false;
+    }
+
+    for (int i = 0; i < info->file_count; i++) {
+        job.fds[i] = open(info->files[i].path, O_RDONLY);
+#if defined(POSIX_FADV_SEQUENTIAL)
+        if (job.fds[i] >= 0) posix_fadvise(job.fds[i], 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+    }
+
+    // Every worker pulls batches until none are left, so each one only needs a single read buffer
+    size_t threads = options->thread_count ? options->thread_count : CoreThreadPool_cpu_count();
+    if (threads > job.batch_count) threads = job.batch_count;
+    CoreThreadPool *pool = CoreThreadPool_create(threads);
+    if (pool) {
+        for (size_t i = 0; i < threads; i++) {
+            CoreThreadPool_submit(pool, recheck_worker, &job);
+        }
+        CoreThreadPool_destroy(pool);
+    } else {
+        recheck_worker(&job);
+    }
+
+    for (int i = 0; i < info->file_count; i++) {
+        if (job.fds[i] >= 0) close(job.fds[i]);
+    }
+
+    result->piece_count = info->piece_count;
+    for (size_t i = 0; i < info->piece_count; i++) {
+        if (job.valid[i]) {
+            result->bitfield[i / 8] |= (uint8_t)(0x80 >> (i % 8));
+            result->valid_count++;
+        }
+    }
+    free(job.valid);
+    free(job.fds);
+    return true;
+}
+
+void TorrentRecheck_result_free(TorrentRecheckResult *result) {
+    if (!result) return;
+    free(result->bitfield);
+    result->bitfield = NULL;
+    result->piece_count = 0;
+    result->valid_count = 0;
+}
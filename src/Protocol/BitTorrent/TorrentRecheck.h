@@ -0,0 +1,31 @@
+#ifndef TORRENTRECHECK_H
+#define TORRENTRECHECK_H
+
+// Hashes everything already on disk against the torrent's piece table, spread over a thread pool.
+// Pieces may span file boundaries, missing or short files just make their pieces invalid.
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "TorrentDownloader.h"
+
+typedef struct {
+    size_t thread_count; // 0: one per CPU
+    size_t read_size;    // Bytes a worker reads at once (rounded to whole pieces, at most 16), 0: 4 MiB
+} TorrentRecheckOptions;
+
+typedef struct {
+    uint8_t *bitfield; // Bit i set if piece i is valid, most significant bit first like the wire protocol
+    size_t piece_count;
+    size_t valid_count;
+} TorrentRecheckResult;
+
+// options may be NULL. Fails if the torrent has no usable piece table.
+bool TorrentRecheck_run(const TorrentInfo *info, const TorrentRecheckOptions *options, TorrentRecheckResult *result);
+void TorrentRecheck_result_free(TorrentRecheckResult *result);
+
+static inline bool TorrentRecheck_has_piece(const TorrentRecheckResult *result, size_t piece) {
+    return (result->bitfield[piece / 8] >> (7 - piece % 8)) & 1;
+}
+
+#endif //TORRENTRECHECK_H
@@ -0,0 +1,140 @@
+#include <check.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "CoreSha1.h"
+
+static void to_hex(const uint8_t *digest, char *hex) {
+    for (int i = 0; i < CORE_SHA1_DIGEST_LENGTH; i++) {
+        sprintf(hex + i * 2, "%02x", digest[i]);
+    }
+}
+
+static const CoreSha1Implementation all_implementations[] = {
+    CORE_SHA1_IMPL_SCALAR, CORE_SHA1_IMPL_SHA_NI, CORE_SHA1_IMPL_ARMV8, CORE_SHA1_IMPL_AVX2, CORE_SHA1_IMPL_AVX512
+};
+#define IMPLEMENTATION_COUNT (sizeof(all_implementations) / sizeof(all_implementations[0]))
+
+START_TEST(test_sha1_known_vectors)
+{
+    struct { const char *input; const char *digest; } vectors[] = {
+        { "", "da39a3ee5e6b4b0d3255bfef95601890afd80709" },
+        { "abc", "a9993e364706816aba3e25717850c26c9cd0d89d" },
+        { "abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq", "84983e441c3bd26ebaae4aa1f95129e5e54670f1" },
+    };
+
+    for (size_t impl = 0; impl < IMPLEMENTATION_COUNT; impl++) {
+        if (!CoreSha1_set_implementation(all_implementations[impl])) continue; // Not on this CPU
+        for (size_t i = 0; i < sizeof(vectors) / sizeof(vectors[0]); i++) {
+            uint8_t digest[CORE_SHA1_DIGEST_LENGTH];
+            char hex[CORE_SHA1_DIGEST_LENGTH * 2 + 1];
+            CoreSha1_hash(vectors[i].input, strlen(vectors[i].input), digest);
+            to_hex(digest, hex);
+            ck_assert_str_eq(hex, vectors[i].digest);
+        }
+
+        // A million 'a', fed in odd-sized pieces so the partial block handling gets used
+        CoreSha1 sha;
+        CoreSha1_init(&sha);
+        char chunk[997];
+        memset(chunk, 'a', sizeof(chunk));
+        size_t remaining = 1000000;
+        while (remaining > 0) {
+            size_t n = remaining < sizeof(chunk) ? remaining : sizeof(chunk);
+            CoreSha1_update(&sha, chunk, n);
+            remaining -= n;
+        }
+        uint8_t digest[CORE_SHA1_DIGEST_LENGTH];
+        char hex[CORE_SHA1_DIGEST_LENGTH * 2 + 1];
+        CoreSha1_final(&sha, digest);
+        to_hex(digest, hex);
+        ck_assert_str_eq(hex, "34aa973cd4c4daa4f61eeb2bdbad27316534016f");
+    }
+    ck_assert(CoreSha1_set_implementation(CORE_SHA1_IMPL_AUTO));
+}
+END_TEST
+
+START_TEST(test_sha1_implementations_agree)
+{
+    ck_assert(CoreSha1_is_supported(CORE_SHA1_IMPL_SCALAR));
+    ck_assert(CoreSha1_set_implementation(CORE_SHA1_IMPL_AUTO));
+    ck_assert(CoreSha1_is_supported(CoreSha1_get_implementation()));
+
+    // Every length around the padding boundaries, hashed by every kernel the CPU has
+    uint8_t data[300];
+    for (size_t i = 0; i < sizeof(data); i++) {
+        data[i] = (uint8_t)(i * 31 + 7);
+    }
+    for (size_t length = 0; length <= sizeof(data); length++) {
+        uint8_t expected[CORE_SHA1_DIGEST_LENGTH];
+        ck_assert(CoreSha1_set_implementation(CORE_SHA1_IMPL_SCALAR));
+        CoreSha1_hash(data, length, expected);
+
+        for (size_t impl = 1; impl < IMPLEMENTATION_COUNT; impl++) {
+            if (!CoreSha1_set_implementation(all_implementations[impl])) continue;
+            uint8_t digest[CORE_SHA1_DIGEST_LENGTH];
+            CoreSha1_hash(data, length, digest);
+            ck_assert(memcmp(digest, expected, sizeof(digest)) == 0);
+        }
+    }
+    ck_assert(CoreSha1_set_implementation(CORE_SHA1_IMPL_AUTO));
+}
+END_TEST
+
+START_TEST(test_sha1_hash_many)
+{
+    // Partial lane batches and every padding case: 0-1 spare bytes, exactly one block, two tail blocks
+    static const size_t lengths[] = { 0, 1, 55, 56, 63, 64, 119, 120, 1000 };
+    uint8_t *buffers[20];
+    for (size_t i = 0; i < 20; i++) {
+        buffers[i] = malloc(1000);
+        for (size_t j = 0; j < 1000; j++) {
+            buffers[i][j] = (uint8_t)(i * 131 + j * 7);
+        }
+    }
+
+    for (size_t l = 0; l < sizeof(lengths) / sizeof(lengths[0]); l++) {
+        uint8_t expected[20][CORE_SHA1_DIGEST_LENGTH];
+        ck_assert(CoreSha1_set_implementation(CORE_SHA1_IMPL_SCALAR));
+        for (size_t i = 0; i < 20; i++) {
+            CoreSha1_hash(buffers[i], lengths[l], expected[i]);
+        }
+
+        for (size_t impl = 0; impl < IMPLEMENTATION_COUNT; impl++) {
+            if (!CoreSha1_set_implementation(all_implementations[impl])) continue;
+            for (size_t count = 1; count <= 20; count++) {
+                uint8_t digests[20][CORE_SHA1_DIGEST_LENGTH];
+                CoreSha1_hash_many((const uint8_t *const *)buffers, lengths[l], count, digests);
+                ck_assert(memcmp(digests, expected, count * CORE_SHA1_DIGEST_LENGTH) == 0);
+            }
+        }
+    }
+
+    for (size_t i = 0; i < 20; i++) {
+        free(buffers[i]);
+    }
+    ck_assert(CoreSha1_set_implementation(CORE_SHA1_IMPL_AUTO));
+}
+END_TEST
+
+Suite *corecrypto_suite(void) {
+    Suite *s = suite_create("CoreCrypto");
+    TCase *tc = tcase_create("CoreCryptoTests");
+
+    tcase_add_test(tc, test_sha1_known_vectors);
+    tcase_add_test(tc, test_sha1_implementations_agree);
+    tcase_add_test(tc, test_sha1_hash_many);
+
+    suite_add_tcase(s, tc);
+    return s;
+}
+
+int main(void) {
+    int failed;
+    Suite *s = corecrypto_suite();
+    SRunner *runner = srunner_create(s);
+    srunner_run_all(runner, CK_NORMAL);
+    failed = srunner_ntests_failed(runner);
+    srunner_free(runner);
+    return (failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
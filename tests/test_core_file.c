@@ -81,6 +81,33 @@ START_TEST(test_corefile_preallocate)
 }
 END_TEST
 
+START_TEST(test_corefile_write_atomic)
+{
+    char hello[] = "Hello, ";
+    char empty[] = "";
+    char name[] = "CoreFile!";
+    struct iovec segments[] = {
+        { hello, strlen(hello) },
+        { empty, 0 },
+        { name, strlen(name) },
+    };
+    ck_assert(CoreFile_write_atomic(TEST_FILENAME, segments, 3));
+    ck_assert(CoreFile_exists(TEST_FILENAME ".tmp") == false);
+
+    CoreFile *cf = CoreFile_open(TEST_FILENAME, "rb");
+    ck_assert_ptr_nonnull(cf);
+    char buffer[32] = {0};
+    ck_assert_uint_eq(CoreFile_read(cf, buffer, sizeof(buffer)), strlen(TEST_CONTENT));
+    ck_assert_str_eq(buffer, TEST_CONTENT);
+    destroy_corefile(cf);
+
+    // A path that can't be written leaves nothing behind
+    ck_assert(CoreFile_write_atomic("no_such_directory/file", segments, 3) == false);
+
+    remove(TEST_FILENAME);
+}
+END_TEST
+
 Suite *corefile_suite(void) {
     Suite *s = suite_create("CoreFile");
     TCase *tc = tcase_create("CoreFileTests");
@@ -89,6 +116,7 @@ Suite *corefile_suite(void) {
     tcase_add_test(tc, test_corefile_read_write_chunk);
     tcase_add_test(tc, test_corefile_exists_and_delete);
     tcase_add_test(tc, test_corefile_preallocate);
+    tcase_add_test(tc, test_corefile_write_atomic);
 
     suite_add_tcase(s, tc);
     return s;
@@ -0,0 +1,66 @@
+#include <check.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdatomic.h>
+#include "CoreThreadPool.h"
+
+static void increment(void *argument) {
+    atomic_fetch_add((atomic_int *)argument, 1);
+}
+
+START_TEST(test_thread_pool_runs_every_job)
+{
+    CoreThreadPool *pool = CoreThreadPool_create(4);
+    ck_assert_ptr_nonnull(pool);
+    ck_assert_uint_eq(CoreThreadPool_thread_count(pool), 4);
+
+    // More jobs than the initial queue holds, so it has to grow while workers are taking from it
+    atomic_int counter;
+    atomic_init(&counter, 0);
+    for (int i = 0; i < 1000; i++) {
+        ck_assert(CoreThreadPool_submit(pool, increment, &counter));
+    }
+    CoreThreadPool_wait(pool);
+    ck_assert_int_eq(atomic_load(&counter), 1000);
+
+    // Reusable after a wait, and destroy finishes what's still queued
+    for (int i = 0; i < 100; i++) {
+        ck_assert(CoreThreadPool_submit(pool, increment, &counter));
+    }
+    CoreThreadPool_destroy(pool);
+    ck_assert_int_eq(atomic_load(&counter), 1100);
+}
+END_TEST
+
+START_TEST(test_thread_pool_defaults)
+{
+    ck_assert_uint_ge(CoreThreadPool_cpu_count(), 1);
+    CoreThreadPool *pool = CoreThreadPool_create(0);
+    ck_assert_ptr_nonnull(pool);
+    ck_assert_uint_eq(CoreThreadPool_thread_count(pool), CoreThreadPool_cpu_count());
+    ck_assert(CoreThreadPool_submit(pool, NULL, NULL) == false);
+    CoreThreadPool_wait(pool); // Nothing queued, returns right away
+    CoreThreadPool_destroy(pool);
+}
+END_TEST
+
+Suite *corethread_suite(void) {
+    Suite *s = suite_create("CoreThread");
+    TCase *tc = tcase_create("CoreThreadTests");
+
+    tcase_add_test(tc, test_thread_pool_runs_every_job);
+    tcase_add_test(tc, test_thread_pool_defaults);
+
+    suite_add_tcase(s, tc);
+    return s;
+}
+
+int main(void) {
+    int failed;
+    Suite *s = corethread_suite();
+    SRunner *runner = srunner_create(s);
+    srunner_run_all(runner, CK_NORMAL);
+    failed = srunner_ntests_failed(runner);
+    srunner_free(runner);
+    return (failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -6,6 +6,7 @@
 #include <string.h>
 
 #include "Bencode.h"
+#include "BencodeReader.h"
 #include "CoreFile.h"
 
 #define TEST_FILENAME      "temp_bencode_test.txt"
@@ -278,7 +279,448 @@ START_TEST(test_save_and_parse_roundtrip)
 }
 END_TEST
 
+// TEST 6: Zero-copy parse, strings and keys must point into the source buffer
+START_TEST(test_parse_zero_copy)
+{
+    const char bstr[] = "d4:listl4:spami7ee4:name4:test5:piece3:\0\1\2e";
+    size_t size = sizeof(bstr) - 1;
+    BencodeParseOptions options = { .zero_copy = true };
+    BencodeItem *item = BencodeItem_parse_with_options(bstr, size, &options);
+    ck_assert_ptr_nonnull(item);
+    ck_assert_int_eq(item->type, BENCODE_TYPE_DICTIONARY);
+
+    BencodeDictionary *dict = item->value.dictionary;
+    ck_assert_uint_eq(dict->count, 3);
+    for (size_t i = 0; i < dict->count; i++) {
+        ck_assert(dict->keys[i]->is_view);
+        ck_assert(dict->keys[i]->str > bstr && dict->keys[i]->str < bstr + size);
+    }
+
+    // "name" -> "test", pointing right after "4:" in the source
+    CoreString *name = dict->values[1]->value.string;
+    ck_assert(name->is_view);
+    ck_assert_ptr_eq(name->str, strstr(bstr, "4:test") + 2);
+    ck_assert_uint_eq(name->length, 4);
+
+    // Binary payloads are kept as-is, embedded NUL bytes included
+    CoreString *piece = dict->values[2]->value.string;
+    ck_assert_uint_eq(piece->length, 3);
+    ck_assert_int_eq(memcmp(piece->str, "\0\1\2", 3), 0);
+
+    // Modifying a view copies it first, the source buffer stays untouched
+    CoreString_append(name, "ing");
+    ck_assert(!name->is_view);
+    ck_assert_str_eq(name->str, "testing");
+    ck_assert_ptr_nonnull(strstr(bstr, "4:test5:"));
+
+    BencodeItem_destroy(item);
+}
+END_TEST
+
+// TEST 7: Arena-backed parse, the whole tree comes from (and goes back to) one arena
+START_TEST(test_parse_arena)
+{
+    const char *bstr = "d8:intervali1800e5:peersl4:abcd4:efghee";
+    CoreArena *arena = CoreArena_create(0);
+    ck_assert_ptr_nonnull(arena);
+    BencodeParseOptions options = { .arena = arena };
+
+    for (int round = 0; round < 3; round++) {
+        BencodeItem *item = BencodeItem_parse_with_options(bstr, strlen(bstr), &options);
+        ck_assert_ptr_nonnull(item);
+        ck_assert(item->flags & BENCODE_ITEM_FLAG_ARENA);
+        ck_assert_uint_gt(arena->used, 0);
+
+        BencodeDictionary *dict = item->value.dictionary;
+        ck_assert_uint_eq(dict->count, 2);
+        ck_assert_str_eq(dict->keys[0]->str, "interval");
+        ck_assert_int_eq(dict->values[0]->value.integer, 1800);
+        ck_assert_uint_eq(dict->values[1]->value.list->count, 2);
+        ck_assert_str_eq(dict->values[1]->value.list->items[1].value.string->str, "efgh");
+
+        BencodeItem_destroy(item); // No-op for arena items
+        CoreArena_reset(arena);
+        ck_assert_uint_eq(arena->used, 0);
+    }
+
+    // Broken input must not leave anything behind either
+    ck_assert_ptr_null(BencodeItem_parse_with_options("d3:keyl4:spam", 13, &options));
+
+    CoreArena_destroy(arena);
+}
+END_TEST
+
+// TEST 8: Dictionary lookups, binary keys and key order validation
+START_TEST(test_dictionary_lookup)
+{
+    // Keys are out of order, and one of them contains a NUL byte
+    const char bstr[] = "d4:spami1e3:cowi2e3:a\0bi3e3:a\0ci4ee";
+    size_t size = sizeof(bstr) - 1;
+    BencodeItem *item = BencodeItem_parse(bstr, size);
+    ck_assert_ptr_nonnull(item);
+
+    BencodeDictionary *dict = item->value.dictionary;
+    ck_assert_uint_eq(dict->count, 4);
+    ck_assert_int_eq(BencodeDictionary_get(dict, "cow")->value.integer, 2);
+    ck_assert_int_eq(BencodeDictionary_get(dict, "spam")->value.integer, 1);
+    ck_assert_int_eq(BencodeDictionary_get_with_length(dict, "a\0b", 3)->value.integer, 3);
+    ck_assert_int_eq(BencodeDictionary_get_with_length(dict, "a\0c", 3)->value.integer, 4);
+    ck_assert_ptr_null(BencodeDictionary_get(dict, "a")); // strcmp would have matched "a\0b"
+    ck_assert_ptr_null(BencodeDictionary_get(dict, "moo"));
+    BencodeItem_destroy(item);
+
+    // Strict mode rejects unsorted and duplicate keys, but accepts sorted ones
+    BencodeParseOptions strict = { .strict_key_order = true };
+    ck_assert_ptr_null(BencodeItem_parse_with_options(bstr, size, &strict));
+    ck_assert_ptr_null(BencodeItem_parse_with_options("d3:cowi1e3:cowi2ee", 18, &strict));
+    item = BencodeItem_parse_with_options("d3:cowi1e4:spami2ee", 19, &strict);
+    ck_assert_ptr_nonnull(item);
+    ck_assert_int_eq(BencodeDictionary_get(item->value.dictionary, "spam")->value.integer, 2);
+    BencodeItem_destroy(item);
+}
+END_TEST
+
+// TEST 9: Items remember their source span, and hashing it matches hashing the re-encoded item
+START_TEST(test_source_span_sha1)
+{
+    const char *bstr = "d4:infod6:lengthi12e4:name4:testee";
+    size_t size = strlen(bstr);
+    BencodeItem *item = BencodeItem_parse_with_options(bstr, size, NULL);
+    ck_assert_ptr_nonnull(item);
+    ck_assert_uint_eq(item->source_start, 0);
+    ck_assert_uint_eq(item->source_end, size);
+
+    BencodeItem *info = BencodeDictionary_get(item->value.dictionary, "info");
+    ck_assert_ptr_nonnull(info);
+    size_t length = 0;
+    const char *span = BencodeItem_source_span(info, bstr, size, &length);
+    ck_assert_ptr_eq(span, bstr + 7);
+    ck_assert_uint_eq(length, size - 8);
+
+    uint8_t from_source[BENCODE_SHA1_LENGTH];
+    ck_assert(BencodeItem_compute_sha1_from_source(info, bstr, size, from_source));
+    uint8_t *reencoded = BencodeItem_compute_sha1(info);
+    ck_assert_ptr_nonnull(reencoded);
+    ck_assert_int_eq(memcmp(from_source, reencoded, BENCODE_SHA1_LENGTH), 0);
+    free(reencoded);
+
+    // Items that weren't parsed have no span
+    BencodeItem *manual = BencodeItem_create(BENCODE_TYPE_INTEGER);
+    ck_assert(!BencodeItem_compute_sha1_from_source(manual, bstr, size, from_source));
+    BencodeItem_destroy(manual);
+    BencodeItem_destroy(item);
+}
+END_TEST
+
+// Records every reader event as text, so feeding styles can be compared
+typedef struct {
+    char log[512];
+    size_t length;
+} ReaderLog;
+
+static void reader_log(ReaderLog *log, const char *text, size_t length) {
+    ck_assert_uint_lt(log->length + length, sizeof(log->log));
+    memcpy(log->log + log->length, text, length);
+    log->length += length;
+    log->log[log->length] = '\0';
+}
+
+static bool log_integer(void *user_data, int64_t value) {
+    char text[32];
+    int n = snprintf(text, sizeof(text), "i%lld ", (long long)value);
+    reader_log(user_data, text, (size_t)n);
+    return true;
+}
+
+static bool log_string(void *user_data, const char *fragment, size_t fragment_length, uint64_t offset, uint64_t total_length) {
+    if (offset == 0) reader_log(user_data, "s:", 2);
+    reader_log(user_data, fragment, fragment_length);
+    if (offset + fragment_length == total_length) reader_log(user_data, " ", 1);
+    return true;
+}
+
+static bool log_key(void *user_data, const char *key, size_t length) {
+    reader_log(user_data, "k:", 2);
+    reader_log(user_data, key, length);
+    reader_log(user_data, " ", 1);
+    return true;
+}
+
+static bool log_list(void *user_data) { reader_log(user_data, "[ ", 2); return true; }
+static bool log_dictionary(void *user_data) { reader_log(user_data, "{ ", 2); return true; }
+static bool log_end(void *user_data) { reader_log(user_data, "} ", 2); return true; }
+
+static const BencodeReaderCallbacks log_callbacks = {
+    .on_integer = log_integer,
+    .on_string = log_string,
+    .on_key = log_key,
+    .on_list_start = log_list,
+    .on_dictionary_start = log_dictionary,
+    .on_end = log_end
+};
+
+static BencodeReaderResult read_all(const char *data, size_t size, size_t chunk, ReaderLog *log) {
+    BencodeReader *reader = BencodeReader_create(&log_callbacks, log);
+    ck_assert_ptr_nonnull(reader);
+    BencodeReaderResult result = BENCODE_READER_OK;
+    for (size_t pos = 0; pos < size && result >= 0; pos += chunk) {
+        result = BencodeReader_feed(reader, data + pos, size - pos < chunk ? size - pos : chunk);
+    }
+    if (result >= 0) result = BencodeReader_finish(reader);
+    BencodeReader_destroy(reader);
+    return result;
+}
+
+// TEST 10: Streaming reader, any chunking gives the same events
+START_TEST(test_streaming_reader)
+{
+    const char *bstr = "d8:completei-12e8:intervali1800e5:peersl6:abcdef0:e4:tagsdee";
+    const char *expected = "{ k:complete i-12 k:interval i1800 k:peers [ s:abcdef s: } k:tags { } } ";
+    for (size_t chunk = 1; chunk <= strlen(bstr); chunk++) {
+        ReaderLog log = {0};
+        ck_assert_int_eq(read_all(bstr, strlen(bstr), chunk, &log), BENCODE_READER_DONE);
+        ck_assert_str_eq(log.log, expected);
+    }
+
+    // BEP3 integer rules, truncation, trailing data and non-string keys
+    const char *invalid[] = { "i-0e", "i03e", "ie", "i-e", "i1-e", "i9223372036854775808e", "l4:spam", "i1ei2e", "di1ei2ee", "d3:keye", "e" };
+    for (size_t i = 0; i < sizeof(invalid) / sizeof(invalid[0]); i++) {
+        ReaderLog log = {0};
+        ck_assert_int_eq(read_all(invalid[i], strlen(invalid[i]), 1, &log), BENCODE_READER_ERROR);
+    }
+    ReaderLog log = {0};
+    ck_assert_int_eq(read_all("i-9223372036854775808e", 22, 3, &log), BENCODE_READER_DONE);
+    ck_assert_str_eq(log.log, "i-9223372036854775808 ");
+
+    // Nesting deeper than BENCODE_MAX_STACK_SIZE is rejected
+    char deep[BENCODE_MAX_STACK_SIZE + 2];
+    memset(deep, 'l', sizeof(deep));
+    BencodeReader *reader = BencodeReader_create(NULL, NULL);
+    ck_assert_int_eq(BencodeReader_feed(reader, deep, BENCODE_MAX_STACK_SIZE), BENCODE_READER_OK);
+    ck_assert_uint_eq(BencodeReader_depth(reader), BENCODE_MAX_STACK_SIZE);
+    ck_assert_int_eq(BencodeReader_feed(reader, deep, 1), BENCODE_READER_ERROR);
+    BencodeReader_destroy(reader);
+}
+END_TEST
+
 // Build the test suite
+START_TEST(test_nesting_limit)
+{
+    // A dictionary holding a list holding a dictionary... ending in an empty list
+    size_t depth = BENCODE_MAX_STACK_SIZE;
+    char *bstr = malloc(depth * 4 + 1);
+    size_t size = 0;
+    for (size_t i = 0; i < depth; i++) {
+        if (i % 2 == 0) {
+            memcpy(bstr + size, "d1:a", 4);
+            size += 4;
+        } else {
+            bstr[size++] = 'l';
+        }
+    }
+    for (size_t i = 0; i < depth; i++) {
+        bstr[size++] = 'e';
+    }
+
+    // Exactly at the limit parses, spans still cover the nested containers
+    BencodeItem *item = BencodeItem_parse_with_options(bstr, size, NULL);
+    ck_assert_ptr_nonnull(item);
+    ck_assert_int_eq(item->type, BENCODE_TYPE_DICTIONARY);
+    BencodeItem *inner = &BencodeDictionary_get(item->value.dictionary, "a")->value.list->items[0];
+    ck_assert_int_eq(inner->type, BENCODE_TYPE_DICTIONARY);
+    ck_assert_uint_eq(inner->source_start, 5);
+    ck_assert_uint_eq(inner->source_end, size - 2);
+    BencodeItem_destroy(item);
+
+    // Allowing one level less rejects it, also when the error is deep inside a dictionary
+    BencodeParseOptions options = { .max_depth = depth - 1 };
+    ck_assert_ptr_null(BencodeItem_parse_with_options(bstr, size, &options));
+    free(bstr);
+
+    // Hostile input that never closes anything fails without running out of stack
+    size = 1000000;
+    bstr = malloc(size);
+    memset(bstr, 'l', size);
+    ck_assert_ptr_null(BencodeItem_parse_with_options(bstr, size, NULL));
+    free(bstr);
+
+    // A dictionary key without a value is an error
+    ck_assert_ptr_null(BencodeItem_parse_with_options("d3:cowe", 7, NULL));
+    ck_assert_ptr_null(BencodeItem_parse_with_options("ld3:cowl", 8, NULL));
+}
+END_TEST
+
+START_TEST(test_parse_number_rules)
+{
+    struct { const char *bstr; int64_t value; } valid[] = {
+        { "i0e", 0 },
+        { "i-1e", -1 },
+        { "i12345678e", 12345678 },
+        { "i1234567890123e", 1234567890123LL },
+        { "i9223372036854775807e", INT64_MAX },
+        { "i-9223372036854775808e", INT64_MIN },
+    };
+    for (size_t i = 0; i < sizeof(valid) / sizeof(valid[0]); i++) {
+        BencodeItem *item = BencodeItem_parse_with_options(valid[i].bstr, strlen(valid[i].bstr), NULL);
+        ck_assert_ptr_nonnull(item);
+        ck_assert_int_eq(item->value.integer, valid[i].value);
+        BencodeItem_destroy(item);
+    }
+
+    // Leading zeros, -0, overflow, empty, and anything that isn't a digit
+    const char *invalid[] = {
+        "i03e", "i-0e", "i-e", "ie", "i--1e", "i+1e", "i 1e", "i1 e", "i12345678ae",
+        "i9223372036854775808e", "i-9223372036854775809e", "i99999999999999999999e",
+        "-1:", "99999999999999999999:x", "3:ab", "12345678:short",
+    };
+    for (size_t i = 0; i < sizeof(invalid) / sizeof(invalid[0]); i++) {
+        ck_assert_ptr_null(BencodeItem_parse_with_options(invalid[i], strlen(invalid[i]), NULL));
+    }
+
+    // A length prefix long enough to go through the 8 digits at a time path
+    size_t length = 12345678;
+    char *bstr = malloc(length + 9);
+    memcpy(bstr, "12345678:", 9);
+    memset(bstr + 9, 'x', length);
+    BencodeParseOptions options = { .zero_copy = true };
+    BencodeItem *item = BencodeItem_parse_with_options(bstr, length + 9, &options);
+    ck_assert_ptr_nonnull(item);
+    ck_assert_uint_eq(item->value.string->length, length);
+    BencodeItem_destroy(item);
+    free(bstr);
+}
+END_TEST
+
+START_TEST(test_to_bytes)
+{
+    // Parsed input round-trips byte for byte, including the integer edge cases
+    const char *bstr = "d3:bari-9223372036854775808e3:fooli0ei9223372036854775807e0:e4:spam4:eggse";
+    BencodeItem *item = BencodeItem_parse_with_options(bstr, strlen(bstr), NULL);
+    ck_assert_ptr_nonnull(item);
+    ck_assert_uint_eq(BencodeItem_encoded_size(item), strlen(bstr));
+
+    size_t size = 0;
+    uint8_t *bytes = BencodeItem_to_bytes(item, &size);
+    ck_assert_ptr_nonnull(bytes);
+    ck_assert_uint_eq(size, strlen(bstr));
+    ck_assert(memcmp(bytes, bstr, size) == 0);
+    free(bytes);
+
+    // Hand-built dictionaries may be out of order, they are still written sorted
+    BencodeDictionary *dict = item->value.dictionary;
+    CoreString *key = dict->keys[0];
+    BencodeItem *value = dict->values[0];
+    dict->keys[0] = dict->keys[2];
+    dict->values[0] = dict->values[2];
+    dict->keys[2] = key;
+    dict->values[2] = value;
+    bytes = BencodeItem_to_bytes(item, &size);
+    ck_assert_ptr_nonnull(bytes);
+    ck_assert_uint_eq(size, strlen(bstr));
+    ck_assert(memcmp(bytes, bstr, size) == 0);
+    free(bytes);
+    BencodeItem_destroy(item);
+}
+END_TEST
+
+START_TEST(test_save_to_path)
+{
+    // A long string goes out straight from the item, the rest through the staging buffer
+    size_t pieces_length = 4000;
+    size_t size = 0;
+    char *bstr = malloc(pieces_length + 64);
+    size += (size_t)sprintf(bstr, "d6:lengthi42e4:name4:file6:pieces%zu:", pieces_length);
+    for (size_t i = 0; i < pieces_length; i++) {
+        bstr[size++] = (char)(i * 7);
+    }
+    size += (size_t)sprintf(bstr + size, "5:zlastli1ei2eee");
+
+    BencodeItem *item = BencodeItem_parse_with_options(bstr, size, NULL);
+    ck_assert_ptr_nonnull(item);
+    ck_assert(BencodeItem_save_to_path(item, TEST_FILENAME));
+    BencodeItem_destroy(item);
+
+    char *buffer = malloc(size + 1);
+    ck_assert_uint_eq(read_file_into_buffer(TEST_FILENAME, buffer, size + 1), size);
+    ck_assert(memcmp(buffer, bstr, size) == 0);
+
+    // Saving again replaces the file instead of appending to it
+    item = BencodeItem_parse_with_options("i7e", 3, NULL);
+    ck_assert(BencodeItem_save_to_path(item, TEST_FILENAME));
+    BencodeItem_destroy(item);
+    ck_assert_uint_eq(read_file_into_buffer(TEST_FILENAME, buffer, size + 1), 3);
+    ck_assert(memcmp(buffer, "i7e", 3) == 0);
+
+    free(buffer);
+    free(bstr);
+    remove_test_file();
+}
+END_TEST
+
+START_TEST(test_parse_lazy)
+{
+    const char *bstr = "d8:announce3:url4:infod5:filesld6:lengthi1e4:pathl1:aeee4:name4:demoe3:zzzli1eee";
+    size_t size = strlen(bstr);
+    CoreArena *arena = CoreArena_create(0);
+    ck_assert_ptr_nonnull(arena);
+
+    // Lazy mode needs an arena
+    BencodeParseOptions options = { .lazy = true };
+    ck_assert_ptr_null(BencodeItem_parse_with_options(bstr, size, &options));
+    options.arena = arena;
+
+    // Only the outer dictionary is decoded, nested containers just know where they are
+    BencodeItem *item = BencodeItem_parse_with_options(bstr, size, &options);
+    ck_assert_ptr_nonnull(item);
+    BencodeDictionary *root = BencodeItem_get_dictionary(item);
+    ck_assert_ptr_nonnull(root);
+    ck_assert_str_eq(BencodeDictionary_get(root, "announce")->value.string->str, "url");
+    BencodeItem *info = BencodeDictionary_get(root, "info");
+    ck_assert_int_eq(info->type, BENCODE_TYPE_DICTIONARY);
+    ck_assert(info->flags & BENCODE_ITEM_FLAG_LAZY);
+
+    // The info-hash only needs the span, it works before and after decoding
+    uint8_t before[BENCODE_SHA1_LENGTH];
+    uint8_t after[BENCODE_SHA1_LENGTH];
+    ck_assert(BencodeItem_compute_sha1_from_source(info, bstr, size, before));
+
+    BencodeDictionary *infod = BencodeItem_get_dictionary(info);
+    ck_assert_ptr_nonnull(infod);
+    ck_assert(!(info->flags & BENCODE_ITEM_FLAG_LAZY));
+    ck_assert_ptr_eq(BencodeItem_get_dictionary(info), infod); // Decoded once
+    ck_assert_str_eq(BencodeDictionary_get(infod, "name")->value.string->str, "demo");
+    ck_assert(BencodeItem_compute_sha1_from_source(info, bstr, size, after));
+    ck_assert(memcmp(before, after, sizeof(before)) == 0);
+
+    BencodeItem *files = BencodeDictionary_get(infod, "files");
+    ck_assert(files->flags & BENCODE_ITEM_FLAG_LAZY);
+    ck_assert_ptr_null(BencodeItem_get_dictionary(files)); // Wrong type
+    BencodeList *file_list = BencodeItem_get_list(files);
+    ck_assert_ptr_nonnull(file_list);
+    ck_assert_uint_eq(file_list->count, 1);
+    BencodeDictionary *file = BencodeItem_get_dictionary(&file_list->items[0]);
+    ck_assert_int_eq(BencodeDictionary_get(file, "length")->value.integer, 1);
+
+    // Partly decoded trees still serialize to the original bytes
+    size_t out_size = 0;
+    uint8_t *bytes = BencodeItem_to_bytes(item, &out_size);
+    ck_assert_uint_eq(out_size, size);
+    ck_assert(memcmp(bytes, bstr, size) == 0);
+    free(bytes);
+
+    // Syntax errors are found up front, errors inside a lazy container only when it is decoded
+    ck_assert_ptr_null(BencodeItem_parse_with_options("d1:ali1e", 8, &options));
+    ck_assert_ptr_null(BencodeItem_parse_with_options("d1:ali01eee", 11, &options));
+    item = BencodeItem_parse_with_options("d1:adi1ei2eee", 13, &options);
+    ck_assert_ptr_nonnull(item);
+    BencodeItem *bad = BencodeDictionary_get(BencodeItem_get_dictionary(item), "a");
+    ck_assert_ptr_null(BencodeItem_get_dictionary(bad));
+    ck_assert(bad->flags & BENCODE_ITEM_FLAG_LAZY);
+
+    CoreArena_destroy(arena);
+}
+END_TEST
+
 Suite *bencode_suite(void) {
     Suite *s = suite_create("Bencode");
     TCase *tc = tcase_create("BencodeTests");
@@ -288,6 +730,16 @@ Suite *bencode_suite(void) {
     tcase_add_test(tc, test_parse_list);
     tcase_add_test(tc, test_parse_dictionary);
     tcase_add_test(tc, test_save_and_parse_roundtrip);
+    tcase_add_test(tc, test_parse_zero_copy);
+    tcase_add_test(tc, test_parse_arena);
+    tcase_add_test(tc, test_dictionary_lookup);
+    tcase_add_test(tc, test_source_span_sha1);
+    tcase_add_test(tc, test_streaming_reader);
+    tcase_add_test(tc, test_nesting_limit);
+    tcase_add_test(tc, test_parse_number_rules);
+    tcase_add_test(tc, test_to_bytes);
+    tcase_add_test(tc, test_save_to_path);
+    tcase_add_test(tc, test_parse_lazy);
 
     suite_add_tcase(s, tc);
     return s;
@@ -0,0 +1,220 @@
+#include <check.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "Bencode.h"
+#include "CoreSha1.h"
+#include "TorrentDownloader.h"
+#include "TorrentRecheck.h"
+#include "TorrentPieceHasher.h"
+
+#define TEST_DIRECTORY "recheck_test"
+#define PIECE_LENGTH 16
+
+// Three files of 20, 0 and 30 bytes: 4 pieces, two of them crossing a file boundary
+static const char *const file_paths[] = { TEST_DIRECTORY "/data/a", TEST_DIRECTORY "/data/b", TEST_DIRECTORY "/data/sub/c" };
+static const size_t file_sizes[] = { 20, 0, 30 };
+#define PAYLOAD_SIZE 50
+#define PIECE_COUNT 4
+
+static void write_payload(const uint8_t *payload) {
+    mkdir(TEST_DIRECTORY, 0755);
+    mkdir(TEST_DIRECTORY "/data", 0755);
+    mkdir(TEST_DIRECTORY "/data/sub", 0755);
+    size_t offset = 0;
+    for (size_t i = 0; i < 3; i++) {
+        FILE *f = fopen(file_paths[i], "wb");
+        ck_assert_ptr_nonnull(f);
+        fwrite(payload + offset, 1, file_sizes[i], f);
+        fclose(f);
+        offset += file_sizes[i];
+    }
+}
+
+static void remove_payload(void) {
+    for (size_t i = 0; i < 3; i++) {
+        remove(file_paths[i]);
+    }
+    rmdir(TEST_DIRECTORY "/data/sub");
+    rmdir(TEST_DIRECTORY "/data");
+    rmdir(TEST_DIRECTORY);
+}
+
+// Builds the .torrent in buffer, returns its length
+static size_t build_torrent(const uint8_t *payload, char *buffer) {
+    size_t n = (size_t)sprintf(buffer, "d4:infod5:filesl"
+                                       "d6:lengthi20e4:pathl1:aee"
+                                       "d6:lengthi0e4:pathl1:bee"
+                                       "d6:lengthi30e4:pathl3:sub1:cee"
+                                       "e4:name4:data12:piece lengthi%de6:pieces%d:",
+                               PIECE_LENGTH, PIECE_COUNT * CORE_SHA1_DIGEST_LENGTH);
+    for (size_t p = 0; p < PIECE_COUNT; p++) {
+        size_t length = p == PIECE_COUNT - 1 ? PAYLOAD_SIZE - p * PIECE_LENGTH : PIECE_LENGTH;
+        CoreSha1_hash(payload + p * PIECE_LENGTH, length, (uint8_t *)buffer + n);
+        n += CORE_SHA1_DIGEST_LENGTH;
+    }
+    buffer[n++] = 'e';
+    buffer[n++] = 'e';
+    return n;
+}
+
+START_TEST(test_multi_file_info)
+{
+    uint8_t payload[PAYLOAD_SIZE] = { 0 };
+    char torrent[512];
+    size_t length = build_torrent(payload, torrent);
+    BencodeItem *root = BencodeItem_parse(torrent, length);
+    ck_assert_ptr_nonnull(root);
+
+    TorrentDownloader *dl = TorrentDownloader_create(root, TEST_DIRECTORY);
+    ck_assert_ptr_nonnull(dl);
+    ck_assert_int_eq(dl->info.type, TORRENT_MULTI_FILE);
+    ck_assert_int_eq(dl->info.file_count, 3);
+    ck_assert_str_eq(dl->info.files[2].path, file_paths[2]);
+    ck_assert_str_eq(dl->info.files[2].file_name, "c");
+    ck_assert_uint_eq(dl->info.files[2].offset, 20);
+    ck_assert_uint_eq(dl->info.total_size, PAYLOAD_SIZE);
+    ck_assert_uint_eq(dl->info.piece_count, PIECE_COUNT);
+    ck_assert_ptr_nonnull(dl->info.piece_hashes);
+    TorrentDownloader_destroy(dl);
+    BencodeItem_destroy(root);
+
+    // Paths that would escape the download directory are refused
+    const char *escaping = "d4:infod5:filesld6:lengthi1e4:pathl2:..1:xeee4:name4:data12:piece lengthi16e6:pieces0:ee";
+    root = BencodeItem_parse(escaping, strlen(escaping));
+    ck_assert_ptr_nonnull(root);
+    ck_assert_ptr_null(TorrentDownloader_create(root, TEST_DIRECTORY));
+    BencodeItem_destroy(root);
+}
+END_TEST
+
+START_TEST(test_recheck_bitfield)
+{
+    uint8_t payload[PAYLOAD_SIZE];
+    for (size_t i = 0; i < PAYLOAD_SIZE; i++) {
+        payload[i] = (uint8_t)(i * 7 + 1);
+    }
+    char torrent[512];
+    size_t length = build_torrent(payload, torrent);
+    BencodeItem *root = BencodeItem_parse(torrent, length);
+    TorrentDownloader *dl = TorrentDownloader_create(root, TEST_DIRECTORY);
+    ck_assert_ptr_nonnull(dl);
+
+    // One piece per batch over several threads, and the defaults (one batch for everything)
+    TorrentRecheckOptions options[] = { { .thread_count = 3, .read_size = PIECE_LENGTH }, { 0 } };
+    for (size_t o = 0; o < 2; o++) {
+        TorrentRecheckResult result;
+        write_payload(payload);
+        ck_assert(TorrentRecheck_run(&dl->info, &options[o], &result));
+        ck_assert_uint_eq(result.piece_count, PIECE_COUNT);
+        ck_assert_uint_eq(result.valid_count, PIECE_COUNT);
+        ck_assert_uint_eq(result.bitfield[0], 0xF0);
+        TorrentRecheck_result_free(&result);
+
+        // Byte 25 lives in c but belongs to piece 1, which starts in a
+        payload[25] ^= 0xFF;
+        write_payload(payload);
+        payload[25] ^= 0xFF;
+        ck_assert(TorrentRecheck_run(&dl->info, &options[o], &result));
+        ck_assert_uint_eq(result.valid_count, 3);
+        ck_assert(!TorrentRecheck_has_piece(&result, 1));
+        ck_assert(TorrentRecheck_has_piece(&result, 0) && TorrentRecheck_has_piece(&result, 2));
+        TorrentRecheck_result_free(&result);
+
+        // Without a there's nothing for pieces 0 and 1, the short last piece is still fine
+        write_payload(payload);
+        remove(file_paths[0]);
+        ck_assert(TorrentRecheck_run(&dl->info, &options[o], &result));
+        ck_assert_uint_eq(result.bitfield[0], 0x30);
+        ck_assert_uint_eq(result.valid_count, 2);
+        TorrentRecheck_result_free(&result);
+    }
+
+    remove_payload();
+    TorrentDownloader_destroy(dl);
+    BencodeItem_destroy(root);
+}
+END_TEST
+
+START_TEST(test_piece_hasher)
+{
+    uint8_t payload[PAYLOAD_SIZE];
+    for (size_t i = 0; i < PAYLOAD_SIZE; i++) {
+        payload[i] = (uint8_t)(i * 13 + 5);
+    }
+    char torrent[512];
+    size_t length = build_torrent(payload, torrent);
+    BencodeItem *root = BencodeItem_parse(torrent, length);
+    TorrentDownloader *dl = TorrentDownloader_create(root, TEST_DIRECTORY);
+    ck_assert_ptr_nonnull(dl);
+
+    // Arrives in 7 byte chunks that never line up with the 16 byte pieces, piece 2 is corrupt
+    payload[40] ^= 1;
+    TorrentPieceHasher hasher;
+    TorrentPieceHasher_init(&hasher, &dl->info, 0);
+    TorrentPieceStatus results[PIECE_COUNT];
+    size_t completed = 0;
+    for (size_t offset = 0; offset < PAYLOAD_SIZE; offset += 7) {
+        size_t chunk = PAYLOAD_SIZE - offset < 7 ? PAYLOAD_SIZE - offset : 7;
+        const uint8_t *data = payload + offset;
+        while (chunk > 0) {
+            TorrentPieceStatus status;
+            size_t piece;
+            size_t taken = TorrentPieceHasher_update(&hasher, data, chunk, &status, &piece);
+            ck_assert_uint_gt(taken, 0);
+            if (status != TORRENT_PIECE_PENDING) {
+                ck_assert_uint_eq(piece, completed);
+                results[completed++] = status;
+            }
+            data += taken;
+            chunk -= taken;
+        }
+    }
+    ck_assert_uint_eq(completed, PIECE_COUNT);
+    ck_assert_int_eq(results[0], TORRENT_PIECE_VALID);
+    ck_assert_int_eq(results[1], TORRENT_PIECE_VALID);
+    ck_assert_int_eq(results[2], TORRENT_PIECE_INVALID);
+    ck_assert_int_eq(results[3], TORRENT_PIECE_VALID);
+
+    // Re-fetching starts at the bad piece, bytes past the payload are left alone
+    payload[40] ^= 1;
+    TorrentPieceHasher_init(&hasher, &dl->info, 2 * PIECE_LENGTH);
+    TorrentPieceStatus status;
+    size_t piece;
+    ck_assert_uint_eq(TorrentPieceHasher_update(&hasher, payload + 32, 18, &status, &piece), 16);
+    ck_assert_int_eq(status, TORRENT_PIECE_VALID);
+    ck_assert_uint_eq(piece, 2);
+    ck_assert_uint_eq(TorrentPieceHasher_update(&hasher, payload + 48, 2, &status, &piece), 2);
+    ck_assert_int_eq(status, TORRENT_PIECE_VALID);
+    ck_assert_uint_eq(piece, 3);
+    ck_assert_uint_eq(TorrentPieceHasher_update(&hasher, payload, 5, &status, &piece), 0);
+    ck_assert_int_eq(status, TORRENT_PIECE_PENDING);
+
+    TorrentDownloader_destroy(dl);
+    BencodeItem_destroy(root);
+}
+END_TEST
+
+Suite *bittorrent_suite(void) {
+    Suite *s = suite_create("BitTorrent");
+    TCase *tc = tcase_create("BitTorrentTests");
+
+    tcase_add_test(tc, test_multi_file_info);
+    tcase_add_test(tc, test_recheck_bitfield);
+    tcase_add_test(tc, test_piece_hasher);
+
+    suite_add_tcase(s, tc);
+    return s;
+}
+
+int main(void) {
+    int failed;
+    Suite *s = bittorrent_suite();
+    SRunner *runner = srunner_create(s);
+    srunner_run_all(runner, CK_NORMAL);
+    failed = srunner_ntests_failed(runner);
+    srunner_free(runner);
+    return (failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}